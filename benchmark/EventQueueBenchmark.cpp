@@ -0,0 +1,66 @@
+#include "BoundedEventQueue.h"
+#include "Event.h"
+#include "EventQueue.h"
+#include "LockFreeEventQueue.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using tsm::Event;
+
+///
+/// Contention benchmark: several producer threads feed a single consumer, the
+/// way I/O threads feed one AsyncExecutionPolicy state machine. Reports the
+/// consumer side throughput for each queue type.
+///
+template<typename EventQueue>
+double
+eventsPerSecond(int producers, int eventsPerProducer)
+{
+    EventQueue eq;
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+
+    threads.reserve(producers);
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&eq, p, eventsPerProducer] {
+            for (int i = 0; i < eventsPerProducer; ++i) {
+                eq.addEvent(Event(static_cast<tsm::event_id_t>(p), i));
+            }
+        });
+    }
+
+    const int total = producers * eventsPerProducer;
+    for (int i = 0; i < total; ++i) {
+        eq.nextEvent();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    for (auto& t : threads) {
+        t.join();
+    }
+    std::chrono::duration<double> elapsed = end - start;
+    return total / elapsed.count();
+}
+
+int
+main()
+{
+    const int EVENTS_PER_PRODUCER = 200000;
+    std::printf("%10s %20s %20s %20s\n", "producers", "EventQueueT ev/s",
+                "LockFreeEventQueueT ev/s", "BoundedEventQueueT ev/s");
+    for (int producers : { 1, 2, 4, 8, 12, 16 }) {
+        double locked = eventsPerSecond<tsm::EventQueueT<Event, std::mutex>>(
+          producers, EVENTS_PER_PRODUCER);
+        double lockFree = eventsPerSecond<tsm::LockFreeEventQueueT<Event>>(
+          producers, EVENTS_PER_PRODUCER);
+        double bounded =
+          eventsPerSecond<tsm::BoundedEventQueue<Event, 1024>>(
+            producers, EVENTS_PER_PRODUCER);
+        std::printf(
+          "%10d %20.0f %20.0f %20.0f\n", producers, locked, lockFree, bounded);
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "Event.h"
+#include "Hsm.h"
+#include "PooledExecutionPolicy.h"
+#include "State.h"
+#include "ThreadPoolExecutor.h"
+#include "WorkStealingExecutor.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using tsm::Event;
+using tsm::Hsm;
+using tsm::State;
+
+///
+/// A machine that does a little work per event, so that scheduling overhead
+/// and cache warmth both show up in the numbers.
+///
+struct Worker : Hsm<Worker>
+{
+    Worker()
+    {
+        setStartState(&a);
+        add(a, tick, b, onTick);
+        add(b, tick, a, onTick);
+    }
+
+    tsm::ActionFn onTick = [this](Event const& e) {
+        for (auto& v : scratch) {
+            v = v * 31 + e.data;
+        }
+        processed.fetch_add(1, std::memory_order_relaxed);
+    };
+
+    State a, b;
+    Event tick;
+    uint32_t scratch[64]{};
+    static std::atomic<uint64_t> processed;
+};
+
+std::atomic<uint64_t> Worker::processed{};
+
+///
+/// Scaling benchmark: MACHINES pooled state machines are fed by a few
+/// producer threads. Reports events per second for each executor as the
+/// number of workers grows.
+///
+template<typename Executor>
+double
+eventsPerSecond(std::size_t workers, int machines, int eventsPerMachine)
+{
+    using Machine = tsm::PooledExecutionPolicy<Worker, Executor>;
+    Executor executor(workers);
+    std::vector<std::unique_ptr<Machine>> sms;
+    for (int i = 0; i < machines; ++i) {
+        sms.emplace_back(new Machine(executor));
+        sms.back()->startSM();
+    }
+    Worker::processed = 0;
+    const uint64_t total = static_cast<uint64_t>(machines) * eventsPerMachine;
+
+    auto start = std::chrono::steady_clock::now();
+    const int PRODUCERS = 4;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&sms, p, machines, eventsPerMachine] {
+            for (int e = 0; e < eventsPerMachine; ++e) {
+                for (int i = p; i < machines; i += PRODUCERS) {
+                    sms[i]->sendEvent(Event(sms[i]->tick.id, e));
+                }
+            }
+        });
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    while (Worker::processed.load(std::memory_order_relaxed) < total) {
+        std::this_thread::yield();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double> elapsed = end - start;
+    return total / elapsed.count();
+}
+
+int
+main()
+{
+    const int MACHINES = 4096;
+    const int EVENTS_PER_MACHINE = 200;
+    std::printf("%10s %25s %25s\n",
+                "workers",
+                "ThreadPoolExecutor ev/s",
+                "WorkStealingExecutor ev/s");
+    for (std::size_t workers : { 1, 2, 4, 8, 16, 32, 64 }) {
+        double shared = eventsPerSecond<tsm::ThreadPoolExecutor>(
+          workers, MACHINES, EVENTS_PER_MACHINE);
+        double stealing = eventsPerSecond<tsm::WorkStealingExecutor>(
+          workers, MACHINES, EVENTS_PER_MACHINE);
+        std::printf("%10zu %25.0f %25.0f\n", workers, shared, stealing);
+    }
+    return 0;
+}
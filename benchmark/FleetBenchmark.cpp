@@ -0,0 +1,115 @@
+#include "DenseTransitionTable.h"
+#include "Event.h"
+#include "Fleet.h"
+#include "Hsm.h"
+#include "MachineDefinition.h"
+#include "State.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using tsm::Event;
+using tsm::State;
+
+enum class SwitchState
+{
+    Off,
+    On,
+    Count
+};
+
+enum class SwitchEvent
+{
+    Toggle,
+    Count
+};
+
+struct NoContext
+{};
+
+struct SwitchDef
+{
+    using Context = NoContext;
+    using States = SwitchState;
+    static constexpr SwitchState initial = SwitchState::Off;
+
+    static void define(tsm::MachineDefinition<SwitchDef>& d)
+    {
+        d.add(SwitchState::Off, SwitchEvent::Toggle, SwitchState::On);
+        d.add(SwitchState::On, SwitchEvent::Toggle, SwitchState::Off);
+    }
+};
+
+constexpr SwitchState SwitchDef::initial;
+
+// The same toggle as one Hsm object per instance
+struct ObjectSwitch
+  : tsm::Hsm<ObjectSwitch, tsm::DenseStateTransitionTableT>
+{
+    ObjectSwitch()
+    {
+        setStartState(&off);
+        add(off, SwitchEvent::Toggle, on);
+        add(on, SwitchEvent::Toggle, off);
+    }
+    State off, on;
+};
+
+const int ROUNDS = 20;
+
+template<typename F>
+double
+nsPerInstance(std::size_t instances, F&& round)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; ++r) {
+        round();
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::nano> elapsed = end - start;
+    return elapsed.count() / (static_cast<double>(ROUNDS) * instances);
+}
+
+///
+/// Bulk stepping benchmark: every instance of a two state toggle gets one
+/// event per round, in a shuffled order. Reports nanoseconds per instance
+/// step for Hsm objects, Fleet::dispatch and the gathered Fleet::step.
+///
+int
+main()
+{
+    const std::size_t N = 1 << 20;
+    std::vector<tsm::instance_id_t> ids(N);
+    std::iota(ids.begin(), ids.end(), 0);
+    std::shuffle(ids.begin(), ids.end(), std::mt19937(42));
+    const Event toggle(SwitchEvent::Toggle);
+
+    std::vector<std::unique_ptr<ObjectSwitch>> objects;
+    for (std::size_t i = 0; i < N; ++i) {
+        objects.emplace_back(new ObjectSwitch());
+        objects.back()->onEntry(Event());
+    }
+    tsm::Fleet<SwitchDef> fleet(N);
+
+    std::printf("%-30s %10s\n", "machines", "ns/step");
+    std::printf("%-30s %10.2f\n", "Hsm objects", nsPerInstance(N, [&] {
+                    for (auto id : ids) {
+                        objects[id]->handle(toggle);
+                    }
+                }));
+    std::printf("%-30s %10.2f\n", "Fleet::dispatch", nsPerInstance(N, [&] {
+                    for (auto id : ids) {
+                        fleet.dispatch(id, toggle);
+                    }
+                }));
+    std::printf("%-30s %10.2f\n", "Fleet::step", nsPerInstance(N, [&] {
+                    fleet.step(ids.data(), ids.size(), toggle);
+                }));
+    std::printf("gather width %zu\n", tsm::detail::STEP_LANES);
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "AsyncExecutionPolicy.h"
+#include "Event.h"
+#include "EventQueue.h"
+#include "Hsm.h"
+#include "LockFreeEventQueue.h"
+#include "State.h"
+#include "WaitStrategy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using tsm::Event;
+using tsm::Hsm;
+using tsm::State;
+
+using Clock = std::chrono::steady_clock;
+
+///
+/// A two state machine whose transition action timestamps the event it is
+/// dispatching. The event data is the index of the sample.
+///
+struct Ping : Hsm<Ping>
+{
+    Ping()
+    {
+        setStartState(&idle);
+        add(idle, ping, busy, onPing);
+        add(busy, ping, idle, onPing);
+    }
+
+    tsm::ActionFn onPing = [this](Event const& e) {
+        received[e.data] = Clock::now();
+    };
+
+    State idle, busy;
+    Event ping;
+    std::vector<Clock::time_point> received;
+};
+
+template<typename EventQueueType>
+struct PingMachine : tsm::AsyncExecutionPolicy<Ping, EventQueueType>
+{
+    explicit PingMachine(std::size_t samples)
+    {
+        this->received.resize(samples);
+    }
+};
+
+///
+/// Send-to-dispatch latency: a producer sends an event every few
+/// microseconds and the state machine thread timestamps it in the
+/// transition action. Reports the 50th and 99th percentile in nanoseconds.
+///
+template<typename EventQueueType>
+void
+measure(char const* name, std::size_t samples, std::chrono::microseconds gap)
+{
+    PingMachine<EventQueueType> sm(samples);
+    std::vector<Clock::time_point> sent(samples);
+    sm.startSM();
+
+    for (std::size_t i = 0; i < samples; ++i) {
+        auto next = Clock::now() + gap;
+        sent[i] = Clock::now();
+        sm.sendEvent(Event(sm.ping.id, static_cast<tsm::event_data_t>(i)));
+        while (Clock::now() < next) {
+        }
+    }
+    // Let the machine catch up before reading its timestamps
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    sm.stopSM();
+
+    std::vector<double> latency;
+    latency.reserve(samples);
+    for (std::size_t i = 0; i < samples; ++i) {
+        latency.push_back(
+          std::chrono::duration<double, std::nano>(sm.received[i] - sent[i])
+            .count());
+    }
+    std::sort(latency.begin(), latency.end());
+    std::printf("%-40s %12.0f %12.0f\n",
+                name,
+                latency[samples / 2],
+                latency[samples * 99 / 100]);
+}
+
+int
+main()
+{
+    const std::size_t SAMPLES = 20000;
+    const std::chrono::microseconds GAP(5);
+
+    std::printf("%-40s %12s %12s\n", "queue", "p50 ns", "p99 ns");
+    measure<tsm::EventQueueT<Event, std::mutex>>(
+      "EventQueueT BlockingWait", SAMPLES, GAP);
+    measure<tsm::EventQueueT<Event, std::mutex, tsm::SpinThenParkWait<>>>(
+      "EventQueueT SpinThenParkWait", SAMPLES, GAP);
+    measure<tsm::LockFreeEventQueueT<Event>>(
+      "LockFreeEventQueueT BlockingWait", SAMPLES, GAP);
+    measure<tsm::LockFreeEventQueueT<Event, tsm::SpinThenParkWait<>>>(
+      "LockFreeEventQueueT SpinThenParkWait", SAMPLES, GAP);
+    return 0;
+}
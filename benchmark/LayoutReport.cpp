@@ -0,0 +1,127 @@
+#include "DenseTransitionTable.h"
+#include "EnumTransitionTable.h"
+#include "Event.h"
+#include "Hsm.h"
+#include "MachineDefinition.h"
+#include "State.h"
+#include "Transition.h"
+
+#include <cstdio>
+
+using tsm::Event;
+using tsm::State;
+
+enum class DoorState
+{
+    Open,
+    Opening,
+    Closing,
+    Closed,
+    StoppedClosing,
+    StoppedOpening,
+    Count
+};
+
+enum class DoorEvent
+{
+    Click,
+    SensorHi,
+    Obstruct,
+    Count
+};
+
+struct NoContext
+{};
+
+struct DoorDef
+{
+    using Context = NoContext;
+    using States = DoorState;
+    static constexpr DoorState initial = DoorState::Closed;
+
+    static void define(tsm::MachineDefinition<DoorDef>& d)
+    {
+        d.add(DoorState::Closed, DoorEvent::Click, DoorState::Opening);
+        d.add(DoorState::Opening, DoorEvent::SensorHi, DoorState::Open);
+        d.add(DoorState::Opening, DoorEvent::Click, DoorState::StoppedOpening);
+        d.add(DoorState::StoppedOpening, DoorEvent::Click, DoorState::Closing);
+        d.add(DoorState::Open, DoorEvent::Click, DoorState::Closing);
+        d.add(DoorState::Closing, DoorEvent::SensorHi, DoorState::Closed);
+        d.add(
+          DoorState::Closing, DoorEvent::Obstruct, DoorState::StoppedClosing);
+        d.add(DoorState::Closing, DoorEvent::Click, DoorState::StoppedClosing);
+        d.add(DoorState::StoppedClosing, DoorEvent::Click, DoorState::Opening);
+    }
+};
+
+constexpr DoorState DoorDef::initial;
+
+// The same garage door as an Hsm, on any table
+template<template<typename> class Table>
+struct DoorHsm : tsm::Hsm<DoorHsm<Table>, Table>
+{
+    DoorHsm()
+    {
+        this->setStartState(&closed);
+        this->add(closed, DoorEvent::Click, opening);
+        this->add(opening, DoorEvent::SensorHi, open);
+        this->add(opening, DoorEvent::Click, stoppedOpening);
+        this->add(stoppedOpening, DoorEvent::Click, closing);
+        this->add(open, DoorEvent::Click, closing);
+        this->add(closing, DoorEvent::SensorHi, closed);
+        this->add(closing, DoorEvent::Obstruct, stoppedClosing);
+        this->add(closing, DoorEvent::Click, stoppedClosing);
+        this->add(stoppedClosing, DoorEvent::Click, opening);
+    }
+
+    State open, opening, closing, closed, stoppedClosing, stoppedOpening;
+};
+
+using HashTable =
+  tsm::StateTransitionTableT<DoorHsm<tsm::StateTransitionTableT>>;
+// An unordered_map node holds the next pointer, the key, the value and the
+// cached hash
+struct HashNode
+{
+    void* next;
+    HashTable::TransitionTableElement element;
+    std::size_t hash;
+};
+
+///
+/// Transition record layouts: the size of a record in each table and the
+/// bytes a lookup touches for the nine transition garage door.
+///
+int
+main()
+{
+    std::printf("%-36s %8s\n", "record", "bytes");
+    std::printf("%-36s %8zu\n",
+                "StateTransitionTableT::Transition",
+                sizeof(HashTable::Transition));
+    std::printf(
+      "%-36s %8zu\n", "  as a hash node (approx.)", sizeof(HashNode));
+    std::printf(
+      "%-36s %8zu\n", "PackedTransition", sizeof(tsm::PackedTransition));
+    std::printf("%-36s %8zu\n",
+                "MachineDefinition::Transition",
+                sizeof(tsm::MachineDefinition<DoorDef>::Transition));
+
+    DoorHsm<tsm::DenseStateTransitionTableT> dense;
+    DoorHsm<tsm::EnumTransitionTable<DoorEvent>::Table> enumTable;
+    tsm::MachineDefinition<DoorDef> const& shared =
+      tsm::MachineDefinition<DoorDef>::get();
+
+    std::printf("\n%-36s %8s\n", "garage door table", "bytes");
+    std::printf("%-36s %8zu\n",
+                "StateTransitionTableT (approx.)",
+                9 * sizeof(HashNode));
+    std::printf("%-36s %8zu\n",
+                "DenseStateTransitionTableT",
+                dense.getTable().tableBytes());
+    std::printf("%-36s %8zu\n",
+                "EnumTransitionTable",
+                enumTable.getTable().tableBytes());
+    std::printf("%-36s %8zu\n", "MachineDefinition", shared.tableBytes());
+    return 0;
+}
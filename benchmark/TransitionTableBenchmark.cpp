@@ -0,0 +1,163 @@
+#include "DenseTransitionTable.h"
+#include "Event.h"
+#include "Hsm.h"
+#include "StaticHsm.h"
+#include "State.h"
+#include "Transition.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+using tsm::Event;
+using tsm::State;
+
+struct Def
+{};
+
+///
+/// Lookup benchmark: a machine with STATES states and EVENTS events where
+/// every state handles every other event. Reports nanoseconds per next() call
+/// for each transition table type over a random (state, event) sequence.
+///
+template<typename Table>
+double
+nsPerLookup(std::vector<std::unique_ptr<State>> const& states,
+            std::vector<Event> const& events,
+            std::vector<std::pair<std::size_t, std::size_t>> const& lookups,
+            bool frozen = false)
+{
+    Table table;
+    for (std::size_t s = 0; s < states.size(); ++s) {
+        for (std::size_t e = 0; e < events.size(); e += 2) {
+            table.add(*states[s], events[e], *states[(s + e) % states.size()]);
+        }
+    }
+
+    if (frozen) {
+        table.freeze();
+    }
+
+    const int ROUNDS = 50;
+    std::size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; ++r) {
+        for (auto const& l : lookups) {
+            found += table.next(*states[l.first], events[l.second]) != nullptr;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    if (found == 0) {
+        std::printf("no transitions found\n");
+    }
+    std::chrono::duration<double, std::nano> elapsed = end - start;
+    return elapsed.count() / (static_cast<double>(ROUNDS) * lookups.size());
+}
+
+struct Off
+{};
+struct On
+{};
+struct Toggle
+{
+    static constexpr tsm::event_id_t id = 1;
+};
+
+// The same two state toggle as a runtime Hsm and as a StaticHsm
+template<template<typename> class Table>
+struct RuntimeSwitch : tsm::Hsm<RuntimeSwitch<Table>, Table>
+{
+    RuntimeSwitch()
+    {
+        this->setStartState(&off);
+        this->add(off, toggle, on);
+        this->add(on, toggle, off);
+    }
+    State off, on;
+    Event toggle{ Toggle::id };
+};
+
+struct StaticSwitch : tsm::StaticHsm<StaticSwitch>
+{
+    using initial_state = Off;
+    using transitions =
+      tsm::TransitionTable<tsm::Row<Off, Toggle, On>, tsm::Row<On, Toggle, Off>>;
+};
+
+///
+/// Dispatch benchmark: nanoseconds per handle() call on a started machine,
+/// including the state change. Each machine gets a warm-up run of N / 16
+/// toggles, then N timed toggles on one thread; the result is the mean.
+///
+/// The numbers are only comparable between rows of one run on one machine.
+/// Build in Release mode, and expect the runtime Hsm rows to include the
+/// State::onEntry and onExit logging, which StaticHsm does not do. For
+/// steadier figures pin the process to a core (e.g. taskset -c 2) and take
+/// the median of several runs.
+///
+template<typename Machine>
+double
+nsPerDispatch()
+{
+    Machine m;
+    m.onEntry(Event());
+    const Event toggle(Toggle::id);
+    const int N = 1 << 22;
+    for (int i = 0; i < N / 16; ++i) {
+        m.handle(toggle);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; ++i) {
+        m.handle(toggle);
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::nano> elapsed = end - start;
+    return elapsed.count() / N;
+}
+
+int
+main()
+{
+    const std::size_t STATES = 48;
+    const std::size_t EVENTS = 48;
+    std::vector<std::unique_ptr<State>> states;
+    for (std::size_t i = 0; i < STATES; ++i) {
+        states.emplace_back(new State());
+    }
+    std::vector<Event> events(EVENTS);
+
+    std::mt19937 rng(42);
+    std::vector<std::pair<std::size_t, std::size_t>> lookups(1 << 16);
+    for (auto& l : lookups) {
+        l.first = rng() % STATES;
+        l.second = rng() % EVENTS;
+    }
+
+    std::printf("%-30s %10s\n", "table", "ns/lookup");
+    std::printf("%-30s %10.2f\n",
+                "StateTransitionTableT",
+                nsPerLookup<tsm::StateTransitionTableT<Def>>(
+                  states, events, lookups));
+    std::printf("%-30s %10.2f\n",
+                "StateTransitionTableT frozen",
+                nsPerLookup<tsm::StateTransitionTableT<Def>>(
+                  states, events, lookups, true));
+    std::printf("%-30s %10.2f\n",
+                "DenseStateTransitionTableT",
+                nsPerLookup<tsm::DenseStateTransitionTableT<Def>>(
+                  states, events, lookups));
+
+    std::printf("\n%-30s %10s\n", "machine", "ns/dispatch");
+    std::printf("%-30s %10.2f\n",
+                "Hsm<StateTransitionTableT>",
+                nsPerDispatch<RuntimeSwitch<tsm::StateTransitionTableT>>());
+    std::printf(
+      "%-30s %10.2f\n",
+      "Hsm<DenseStateTransitionTableT>",
+      nsPerDispatch<RuntimeSwitch<tsm::DenseStateTransitionTableT>>());
+    std::printf(
+      "%-30s %10.2f\n", "StaticHsm", nsPerDispatch<StaticSwitch>());
+    return 0;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace tsm {
+
+///
+/// A monotonic arena: allocations are carved one after the other out of
+/// large blocks and are never freed individually; everything goes at once
+/// when the arena is released or destroyed. Building a machine (or a whole
+/// Fleet) out of one arena puts its tables next to each other in memory,
+/// makes each allocation a pointer bump and teardown a handful of frees.
+///
+/// Containers take memory from an arena through ArenaAllocator. An arena is
+/// not thread safe, and it must outlive everything built out of it.
+///
+class Arena
+{
+  public:
+    explicit Arena(std::size_t blockSize = 64 * 1024)
+      : blockSize_(blockSize)
+    {}
+
+    Arena(Arena const&) = delete;
+    Arena& operator=(Arena const&) = delete;
+
+    ~Arena() { release(); }
+
+    // Blocks come from operator new, so alignment is at most that of
+    // std::max_align_t
+    void* allocate(std::size_t bytes, std::size_t alignment)
+    {
+        std::size_t offset = (used_ + alignment - 1) & ~(alignment - 1);
+        if (blocks_.empty() || offset + bytes > capacity_) {
+            const std::size_t size = bytes > blockSize_ ? bytes : blockSize_;
+            blocks_.push_back(static_cast<char*>(::operator new(size)));
+            capacity_ = size;
+            offset = 0;
+        }
+        used_ = offset + bytes;
+        allocated_ += bytes;
+        return blocks_.back() + offset;
+    }
+
+    // Frees every block. Nothing built out of the arena may be used after.
+    void release()
+    {
+        for (char* block : blocks_) {
+            ::operator delete(block);
+        }
+        blocks_.clear();
+        capacity_ = 0;
+        used_ = 0;
+        allocated_ = 0;
+    }
+
+    // Bytes handed out so far, and the number of blocks they came from
+    std::size_t allocated() const { return allocated_; }
+    std::size_t blockCount() const { return blocks_.size(); }
+
+    // The arena of the innermost ArenaScope on this thread, if any
+    static Arena*& current()
+    {
+        thread_local Arena* arena = nullptr;
+        return arena;
+    }
+
+  private:
+    std::size_t blockSize_;
+    std::vector<char*> blocks_;
+    std::size_t capacity_{};
+    std::size_t used_{};
+    std::size_t allocated_{};
+};
+
+///
+/// Makes arena the one that ArenaAllocators constructed on this thread use,
+/// until the scope ends:
+///
+/// Arena arena;
+/// {
+///     ArenaScope scope(arena);
+///     sm.reset(new MyHsm());  // its tables are allocated out of arena
+/// }
+///
+struct ArenaScope
+{
+    explicit ArenaScope(Arena& arena)
+      : previous_(Arena::current())
+    {
+        Arena::current() = &arena;
+    }
+
+    ArenaScope(ArenaScope const&) = delete;
+    ArenaScope& operator=(ArenaScope const&) = delete;
+
+    ~ArenaScope() { Arena::current() = previous_; }
+
+  private:
+    Arena* previous_;
+};
+
+///
+/// An allocator that takes memory from an arena, or from the heap when it
+/// has none. Pass the arena explicitly, ArenaAllocator<char>(arena), or
+/// default construct it inside an ArenaScope to use the scope's arena; a
+/// default constructed allocator outside any scope uses the heap. Containers
+/// copy their allocator into the nodes and buffers they allocate later, so a
+/// container built in a scope keeps using that arena after the scope ends.
+/// Deallocating arena memory does nothing; the arena frees it in bulk.
+///
+/// Allocators of different arenas compare unequal. They travel with the
+/// elements when a container is move assigned or swapped, so containers of
+/// different arenas can be moved and swapped safely; copy assignment keeps
+/// the destination's arena.
+///
+template<typename T>
+struct ArenaAllocator
+{
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    ArenaAllocator() noexcept
+      : arena_(Arena::current())
+    {}
+
+    explicit ArenaAllocator(Arena& arena) noexcept
+      : arena_(&arena)
+    {}
+
+    // nullptr for the heap
+    explicit ArenaAllocator(Arena* arena) noexcept
+      : arena_(arena)
+    {}
+
+    template<typename U>
+    ArenaAllocator(ArenaAllocator<U> const& other) noexcept
+      : arena_(other.arena())
+    {}
+
+    T* allocate(std::size_t n)
+    {
+        if (arena_ == nullptr) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t /*n*/) noexcept
+    {
+        if (arena_ == nullptr) {
+            ::operator delete(p);
+        }
+    }
+
+    Arena* arena() const noexcept { return arena_; }
+
+  private:
+    Arena* arena_;
+};
+
+template<typename T, typename U>
+bool
+operator==(ArenaAllocator<T> const& a, ArenaAllocator<U> const& b)
+{
+    return a.arena() == b.arena();
+}
+
+template<typename T, typename U>
+bool
+operator!=(ArenaAllocator<T> const& a, ArenaAllocator<U> const& b)
+{
+    return !(a == b);
+}
+
+} // namespace tsm
@@ -3,19 +3,28 @@
 #include "Event.h"
 #include "EventQueue.h"
 
+#include <atomic>
+#include <cstddef>
+#include <deque>
 #include <thread>
 ///
 /// The default policy class for asynchronous event processing. This policy is
 /// mixed in with a Hsm class to create an AsynchronousHsm. The client uses
 /// the sendEvent method to communicate with the state machine. A separate
 /// thread is created and blocks wating on events in the step method.
+/// The event queue type can be swapped out, e.g. for a LockFreeEventQueue when
+/// many producer threads feed a single state machine.
+///
+/// In batch mode (setBatchSize) the thread takes several pending events from
+/// the queue under one lock acquisition and dispatches them back-to-back.
 ///
 namespace tsm {
 
-template<typename StateType>
+template<typename StateType,
+         typename EventQueueType = EventQueueT<Event, std::mutex>>
 struct AsyncExecutionPolicy : public StateType
 {
-    using EventQueue = EventQueueT<Event, std::mutex>;
+    using EventQueue = EventQueueType;
     using ThreadCallback = void (AsyncExecutionPolicy::*)();
 
     AsyncExecutionPolicy()
@@ -29,6 +38,7 @@ struct AsyncExecutionPolicy : public StateType
 
     virtual ~AsyncExecutionPolicy()
     {
+        eventQueue_.stop();
         interrupt_ = true;
         if (smThread_.joinable()) {
             smThread_.join();
@@ -51,18 +61,47 @@ struct AsyncExecutionPolicy : public StateType
 
     virtual void step()
     {
-        while (!interrupt_) {
-            processEvent();
+        if (batchSize_ == 1) {
+            while (!interrupt_) {
+                processEvent();
+            }
+        } else {
+            while (!interrupt_) {
+                processEvents();
+            }
         }
     };
 
-    void sendEvent(Event const& event) { eventQueue_.addEvent(event); }
+    // Take up to batchSize events per queue access; 0 drains every pending
+    // event. The default of 1 processes one event per queue access. Call
+    // before startSM.
+    void setBatchSize(std::size_t batchSize) { batchSize_ = batchSize; }
+    std::size_t getBatchSize() const { return batchSize_; }
+
+    // Returns false if the event queue refused the event, e.g. a full
+    // BoundedEventQueue with OverflowPolicy::Reject, or dropped it as a
+    // Coalesce::KeepPending duplicate.
+    bool sendEvent(Event const& event) { return eventQueue_.addEvent(event); }
+
+    // Queue a range of events with a single queue access and a single wakeup.
+    // Events keep their relative order. Returns the number of events queued.
+    template<typename InputIt>
+    std::size_t sendEvents(InputIt first, InputIt last)
+    {
+        return eventQueue_.addEvents(first, last);
+    }
+
+    // Access to queue specific configuration, e.g. the lanes of a
+    // PriorityEventQueue or the counters of a BoundedEventQueue.
+    EventQueue& getEventQueue() { return eventQueue_; }
 
   protected:
     ThreadCallback threadCallback_;
     std::thread smThread_;
     EventQueue eventQueue_;
-    bool interrupt_{};
+    std::atomic<bool> interrupt_{};
+    std::size_t batchSize_{ 1 };
+    std::deque<Event> batch_;
 
     void processEvent()
     {
@@ -76,6 +115,22 @@ struct AsyncExecutionPolicy : public StateType
             LOG(WARNING) << this->id << ": Exiting event loop on interrupt";
         }
     }
+
+    void processEvents()
+    {
+        // This is a blocking wait
+        eventQueue_.nextEvents(batch_, batchSize_);
+        while (!batch_.empty()) {
+            // An event in the batch may have stopped the state machine
+            if (interrupt_) {
+                LOG(WARNING) << this->id << ": Exiting event loop on interrupt";
+                batch_.clear();
+                break;
+            }
+            StateType::dispatch(batch_.front());
+            batch_.pop_front();
+        }
+    }
 };
 
 ///
@@ -84,24 +139,31 @@ struct AsyncExecutionPolicy : public StateType
 /// each event - specifically, right before the blocking wait for the next
 /// event.
 ///
-template<typename StateType, typename Observer>
+template<typename StateType,
+         typename Observer,
+         typename EventQueueType = EventQueueT<Event, std::mutex>>
 struct AsyncExecWithObserver
-  : public AsyncExecutionPolicy<StateType>
+  : public AsyncExecutionPolicy<StateType, EventQueueType>
   , public Observer
 {
-    using AsyncExecutionPolicy<StateType>::interrupt_;
+    using AsyncExecutionPolicy<StateType, EventQueueType>::interrupt_;
     using Observer::notify;
 
     AsyncExecWithObserver()
-      : AsyncExecutionPolicy<StateType>()
+      : AsyncExecutionPolicy<StateType, EventQueueType>()
       , Observer()
     {}
 
+    // In batch mode notify is called once per batch, after its last event
     void step() override
     {
         while (!interrupt_) {
             notify();
-            this->processEvent();
+            if (this->batchSize_ == 1) {
+                this->processEvent();
+            } else {
+                this->processEvents();
+            }
         }
     }
 };
@@ -0,0 +1,293 @@
+#pragma once
+
+#include "WaitStrategy.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+namespace tsm {
+
+///
+/// What a BoundedEventQueueT does when an event arrives and the queue is full.
+///
+enum class OverflowPolicy
+{
+    Block,      ///< The producer waits until the consumer frees a slot.
+    Reject,     ///< addEvent returns false and the event is not queued.
+    DropOldest, ///< The oldest queued event is discarded to make room.
+    DropNewest, ///< The incoming event is discarded.
+};
+
+///
+/// A thread safe, fixed capacity event queue backed by a cache-line aligned
+/// ring buffer. Unlike EventQueueT it never allocates after construction, so a
+/// stalled state machine cannot make memory grow without bound. Every event
+/// that is rejected or dropped is counted. It can be plugged into
+/// AsyncExecutionPolicy as its EventQueueType.
+///
+template<typename Event,
+         typename LockType,
+         std::size_t Capacity,
+         OverflowPolicy Policy = OverflowPolicy::Block>
+struct BoundedEventQueueT
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of two");
+
+  public:
+    BoundedEventQueueT() = default;
+    BoundedEventQueueT(BoundedEventQueueT const&) = delete;
+    BoundedEventQueueT(BoundedEventQueueT&&) = delete;
+    BoundedEventQueueT operator=(BoundedEventQueueT const&) = delete;
+    BoundedEventQueueT operator=(BoundedEventQueueT&&) = delete;
+
+    ~BoundedEventQueueT()
+    {
+        stop();
+        while (head_ != tail_) {
+            pop();
+        }
+    }
+
+    // Block until you get an event
+    Event nextEvent()
+    {
+        std::unique_lock<LockType> lock(eventQueueMutex_);
+        cvEventAvailable_.wait(
+          lock, [this] { return (!this->empty() || this->interrupt_); });
+        if (interrupt_) {
+            return Event();
+        }
+        const Event e = pop();
+        // All of them: a producer of a range may need more than this slot,
+        // and must not be the only one woken
+        if (blockedProducers_ > 0) {
+            cvSpaceAvailable_.notify_all();
+        }
+        return e;
+    }
+
+    // Block until at least one event is available, then move up to maxEvents
+    // of them (all pending events if maxEvents is 0) to the back of events
+    // under a single lock acquisition. Returns the number of events taken.
+    std::size_t nextEvents(std::deque<Event>& events, std::size_t maxEvents = 0)
+    {
+        std::unique_lock<LockType> lock(eventQueueMutex_);
+        cvEventAvailable_.wait(
+          lock, [this] { return (!this->empty() || this->interrupt_); });
+        if (interrupt_) {
+            return 0;
+        }
+        std::size_t n = static_cast<std::size_t>(tail_ - head_);
+        if (maxEvents != 0 && maxEvents < n) {
+            n = maxEvents;
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            events.push_back(pop());
+        }
+        if (blockedProducers_ > 0) {
+            cvSpaceAvailable_.notify_all();
+        }
+        return n;
+    }
+
+    // Returns false if the event was not queued, either because the overflow
+    // policy discarded it or because the queue was stopped.
+    bool addEvent(Event const& e)
+    {
+        std::unique_lock<LockType> lock(eventQueueMutex_);
+        if (interrupt_) {
+            return false;
+        }
+        if (full()) {
+            switch (Policy) {
+                case OverflowPolicy::Block:
+                    ++blockedProducers_;
+                    cvSpaceAvailable_.wait(lock, [this] {
+                        return (!this->full() || this->interrupt_);
+                    });
+                    --blockedProducers_;
+                    if (interrupt_) {
+                        return false;
+                    }
+                    break;
+                case OverflowPolicy::Reject:
+                    rejected_.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                case OverflowPolicy::DropOldest:
+                    pop();
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    break;
+                case OverflowPolicy::DropNewest:
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+            }
+        }
+        push(e);
+        cvEventAvailable_.notify_all();
+        return true;
+    }
+
+    // Add a range of events under one lock acquisition and wake the consumer
+    // once. The overflow policy applies to the range as a whole: Reject
+    // refuses the entire range unless all of it fits, Block waits for room for
+    // the entire range (ranges larger than Capacity are added as room frees
+    // up), DropOldest and DropNewest discard the excess. Returns the number of
+    // events added, none once the queue is stopped.
+    template<typename ForwardIt>
+    std::size_t addEvents(ForwardIt first, ForwardIt last)
+    {
+        const auto n = static_cast<std::size_t>(std::distance(first, last));
+        std::unique_lock<LockType> lock(eventQueueMutex_);
+        std::size_t added = 0;
+        if (interrupt_) {
+            return added;
+        }
+        switch (Policy) {
+            case OverflowPolicy::Block:
+                while (first != last) {
+                    const std::size_t wanted =
+                      (n - added < Capacity) ? n - added : Capacity;
+                    ++blockedProducers_;
+                    cvSpaceAvailable_.wait(lock, [this, wanted] {
+                        return (this->freeSlots() >= wanted ||
+                                this->interrupt_);
+                    });
+                    --blockedProducers_;
+                    if (interrupt_) {
+                        return added;
+                    }
+                    for (std::size_t i = 0; i < wanted; ++i, ++first) {
+                        push(*first);
+                    }
+                    added += wanted;
+                    cvEventAvailable_.notify_all();
+                }
+                return added;
+            case OverflowPolicy::Reject:
+                if (freeSlots() < n) {
+                    rejected_.fetch_add(n, std::memory_order_relaxed);
+                    return 0;
+                }
+                break;
+            case OverflowPolicy::DropOldest:
+                for (; first != last; ++first) {
+                    if (full()) {
+                        pop();
+                        dropped_.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    push(*first);
+                    ++added;
+                }
+                if (added != 0) {
+                    cvEventAvailable_.notify_all();
+                }
+                return added;
+            case OverflowPolicy::DropNewest:
+                if (freeSlots() < n) {
+                    dropped_.fetch_add(n - freeSlots(),
+                                       std::memory_order_relaxed);
+                }
+                break;
+        }
+        for (; first != last && !full(); ++first) {
+            push(*first);
+            ++added;
+        }
+        if (added != 0) {
+            cvEventAvailable_.notify_all();
+        }
+        return added;
+    }
+
+    void stop()
+    {
+        std::lock_guard<LockType> lock(eventQueueMutex_);
+        interrupt_ = true;
+        cvEventAvailable_.notify_all();
+        cvSpaceAvailable_.notify_all();
+    }
+
+    bool interrupted() { return interrupt_; }
+
+    std::size_t size()
+    {
+        std::lock_guard<LockType> lock(eventQueueMutex_);
+        return static_cast<std::size_t>(tail_ - head_);
+    }
+
+    static constexpr std::size_t capacity() { return Capacity; }
+
+    // Number of events refused by OverflowPolicy::Reject
+    uint64_t rejectedCount() const
+    {
+        return rejected_.load(std::memory_order_relaxed);
+    }
+
+    // Number of events discarded by OverflowPolicy::DropOldest/DropNewest
+    uint64_t droppedCount() const
+    {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    static constexpr uint64_t MASK = Capacity - 1;
+
+    bool empty() const { return head_ == tail_; }
+    bool full() const { return tail_ - head_ == Capacity; }
+    std::size_t freeSlots() const
+    {
+        return Capacity - static_cast<std::size_t>(tail_ - head_);
+    }
+
+    Event* slot(uint64_t index)
+    {
+        return reinterpret_cast<Event*>(&slots_[index & MASK]);
+    }
+
+    void push(Event const& e)
+    {
+        new (slot(tail_)) Event(e);
+        ++tail_;
+    }
+
+    Event pop()
+    {
+        Event* s = slot(head_);
+        Event e = std::move(*s);
+        s->~Event();
+        ++head_;
+        return e;
+    }
+
+    // The slots and the bookkeeping live on separate cache lines so the
+    // consumer reading an event does not bounce the line holding the lock.
+    alignas(CACHE_LINE_SIZE) typename std::aligned_storage<sizeof(Event),
+                                                           alignof(Event)>::type
+      slots_[Capacity];
+
+    alignas(CACHE_LINE_SIZE) LockType eventQueueMutex_;
+    std::condition_variable_any cvEventAvailable_;
+    std::condition_variable_any cvSpaceAvailable_;
+    uint64_t head_{};
+    uint64_t tail_{};
+    std::size_t blockedProducers_{};
+    std::atomic<bool> interrupt_{};
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> rejected_{};
+    std::atomic<uint64_t> dropped_{};
+};
+
+template<typename Event,
+         std::size_t Capacity,
+         OverflowPolicy Policy = OverflowPolicy::Block>
+using BoundedEventQueue = BoundedEventQueueT<Event, std::mutex, Capacity, Policy>;
+
+} // namespace tsm
@@ -0,0 +1,230 @@
+#pragma once
+
+///
+/// CoroutineExecutionPolicy needs C++20 coroutines. With older compilers or
+/// language modes this header is empty.
+///
+#if defined(__has_include)
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+#define TSM_HAS_COROUTINES 1
+#endif
+#endif
+
+#ifdef TSM_HAS_COROUTINES
+
+#include "Event.h"
+
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+namespace tsm {
+
+///
+/// Resumes a suspended coroutine: inline, on a thread pool, or by posting it
+/// to an event loop (epoll, io_uring, asio, ...).
+///
+using CoroutineScheduler = std::function<void(std::coroutine_handle<>)>;
+
+///
+/// An execution policy whose event loop is a coroutine. Instead of blocking a
+/// thread on a condition variable, the loop co_awaits the next event and is
+/// suspended while the queue is empty; it holds no thread while it waits.
+/// sendEvent hands the suspended loop to the scheduler, which resumes it
+/// wherever it likes. The default scheduler resumes it inline, i.e. the
+/// event is processed on the thread that sent it.
+///
+/// There is only ever one loop per machine and it is either suspended or
+/// running, so events are still processed one at a time and in order.
+///
+/// The scheduler must have run every resumption it was given before the
+/// machine is destroyed.
+///
+template<typename StateType>
+struct CoroutineExecutionPolicy : public StateType
+{
+    CoroutineExecutionPolicy()
+      : scheduler_([](std::coroutine_handle<> h) { h.resume(); })
+    {}
+
+    CoroutineExecutionPolicy(CoroutineExecutionPolicy const&) = delete;
+    CoroutineExecutionPolicy operator=(CoroutineExecutionPolicy const&) =
+      delete;
+    CoroutineExecutionPolicy(CoroutineExecutionPolicy&&) = delete;
+    CoroutineExecutionPolicy operator=(CoroutineExecutionPolicy&&) = delete;
+
+    virtual ~CoroutineExecutionPolicy()
+    {
+        std::lock_guard<std::mutex> lock(eventQueueMutex_);
+        interrupt_ = true;
+        if (loop_ && (waiter_ || loop_.done())) {
+            loop_.destroy();
+        }
+    }
+
+    // Call before startSM.
+    void setScheduler(CoroutineScheduler scheduler)
+    {
+        scheduler_ = std::move(scheduler);
+    }
+
+    void onEntry(Event const& e) override
+    {
+        StateType::onEntry(e);
+        {
+            std::lock_guard<std::mutex> lock(eventQueueMutex_);
+            interrupt_ = false;
+            if (loop_) {
+                loop_.destroy();
+                waiter_ = nullptr;
+            }
+            loop_ = eventLoop().handle;
+        }
+        scheduler_(loop_);
+    }
+
+    // Lets a suspended loop run to completion. Pending events are dropped.
+    void onExit(Event const& e) override
+    {
+        resume(takeWaiter([this] {
+            this->interrupt_ = true;
+            this->eventQueue_.clear();
+        }));
+        StateType::onExit(e);
+    }
+
+    bool sendEvent(Event const& event)
+    {
+        resume(takeWaiter(
+          [this, &event] { this->eventQueue_.push_back(event); }));
+        return true;
+    }
+
+    // Queue a range of events and resume the loop at most once.
+    template<typename InputIt>
+    std::size_t sendEvents(InputIt first, InputIt last)
+    {
+        std::size_t n = 0;
+        resume(takeWaiter([this, &first, &last, &n] {
+            for (; first != last; ++first, ++n) {
+                this->eventQueue_.push_back(*first);
+            }
+        }));
+        return n;
+    }
+
+    ///
+    /// The awaitable returned by nextEvent. The loop only suspends if the
+    /// queue is empty; the next sendEvent resumes it.
+    ///
+    struct NextEvent
+    {
+        CoroutineExecutionPolicy& policy;
+
+        bool await_ready() { return policy.hasEvent(); }
+
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            std::lock_guard<std::mutex> lock(policy.eventQueueMutex_);
+            if (!policy.eventQueue_.empty() || policy.interrupt_) {
+                return false;
+            }
+            policy.waiter_ = h;
+            return true;
+        }
+
+        Event await_resume()
+        {
+            std::lock_guard<std::mutex> lock(policy.eventQueueMutex_);
+            if (policy.interrupt_) {
+                return Event();
+            }
+            Event e = policy.eventQueue_.front();
+            policy.eventQueue_.pop_front();
+            return e;
+        }
+    };
+
+    NextEvent nextEvent() { return NextEvent{ *this }; }
+
+  protected:
+    ///
+    /// A coroutine that starts suspended, so that the scheduler runs it from
+    /// the start too, and stays suspended at the end until it is destroyed.
+    ///
+    struct Loop
+    {
+        struct promise_type
+        {
+            Loop get_return_object()
+            {
+                return Loop{
+                    std::coroutine_handle<promise_type>::from_promise(*this)
+                };
+            }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    Loop eventLoop()
+    {
+        for (;;) {
+            Event e = co_await nextEvent();
+            if (interrupted()) {
+                break;
+            }
+            // go down the Hsm hierarchy to handle the event as that is the
+            // "most active state"
+            StateType::dispatch(e);
+        }
+    }
+
+    bool hasEvent()
+    {
+        std::lock_guard<std::mutex> lock(eventQueueMutex_);
+        return !eventQueue_.empty() || interrupt_;
+    }
+
+    bool interrupted()
+    {
+        std::lock_guard<std::mutex> lock(eventQueueMutex_);
+        return interrupt_;
+    }
+
+    // Apply update to the queue and take the suspended loop, if any, so it
+    // can be resumed outside the lock.
+    template<typename Update>
+    std::coroutine_handle<> takeWaiter(Update&& update)
+    {
+        std::lock_guard<std::mutex> lock(eventQueueMutex_);
+        update();
+        return std::exchange(waiter_, nullptr);
+    }
+
+    void resume(std::coroutine_handle<> h)
+    {
+        if (h) {
+            scheduler_(h);
+        }
+    }
+
+    CoroutineScheduler scheduler_;
+    std::mutex eventQueueMutex_;
+    std::deque<Event> eventQueue_;
+    std::coroutine_handle<> waiter_;
+    std::coroutine_handle<typename Loop::promise_type> loop_;
+    bool interrupt_{};
+};
+
+} // namespace tsm
+
+#endif // TSM_HAS_COROUTINES
@@ -0,0 +1,172 @@
+#pragma once
+#include "Arena.h"
+#include "Event.h"
+#include "State.h"
+#include "Transition.h"
+#include "UniqueId.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace tsm {
+
+///
+/// A transition table for small machines that stores transitions in a flat
+/// 2D array instead of a hash map. States and events get dense per-machine
+/// indices, in the order add() first sees them; a lookup maps both ids to
+/// their index and then reads cell [state * stride + event], which holds the
+/// position of the transition. There is no hashing and no bucket chasing.
+/// Transitions are PackedTransition records.
+///
+/// Select it per machine with the second template parameter of Hsm:
+/// struct MyHsm : Hsm<MyHsm, DenseStateTransitionTableT> { ... };
+///
+/// Allocator works as for BasicStateTransitionTableT.
+///
+template<typename FsmDef, typename Allocator>
+struct BasicDenseStateTransitionTableT
+{
+    template<typename T>
+    using Alloc =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+    using Transition = PackedTransition;
+    using EventSet = std::set<Event, std::less<Event>, Alloc<Event>>;
+    using allocator_type = Allocator;
+
+  public:
+    BasicDenseStateTransitionTableT() = default;
+
+    explicit BasicDenseStateTransitionTableT(Allocator const& allocator)
+      : states_(Alloc<uint32_t>(allocator))
+      , events_(Alloc<uint32_t>(allocator))
+      , cells_(Alloc<uint16_t>(allocator))
+      , transitions_(allocator)
+      , eventSet_(Alloc<Event>(allocator))
+    {}
+
+    Transition* next(State& fromState, Event const& onEvent)
+    {
+        const std::size_t s = states_.find(fromState.id);
+        const std::size_t e = events_.find(onEvent.id);
+        if (s == DenseIndex::NONE || e == DenseIndex::NONE) {
+            return nullptr;
+        }
+        const uint16_t cell = cells_[(s << strideShift_) + e];
+        return cell == 0 ? nullptr : transitions_.at(cell);
+    }
+
+    bool doTransition(Transition* t, FsmDef* hsm, Event const& e)
+    {
+        return transitions_.doTransition(*t, hsm, e);
+    }
+
+    State& target(Transition const& t) const { return transitions_.target(t); }
+
+    // As with StateTransitionTableT, the first transition added for a
+    // (state, event) pair wins. Throws std::length_error past
+    // PackedTransitions' limits.
+    void add(State& fromState,
+             Event const& onEvent,
+             State& toState,
+             ActionFn action = nullptr,
+             GuardFn guard = nullptr)
+    {
+        insert(fromState, onEvent, toState, action, guard, 0);
+    }
+
+    // A transition that runs action without leaving state; it shares the
+    // cell of (state, event) with add, first one wins
+    void addInternal(State& state,
+                     Event const& onEvent,
+                     ActionFn action = nullptr,
+                     GuardFn guard = nullptr)
+    {
+        insert(
+          state, onEvent, state, action, guard, PackedTransition::INTERNAL);
+    }
+
+    EventSet const& getEvents() const { return eventSet_; }
+
+    // Lookups are already array reads, there is nothing to build.
+    void freeze() {}
+
+    // Dense indices, assigned as in StateTransitionTableT
+    std::size_t stateIndex(State const& s) const { return states_.find(s.id); }
+    std::size_t eventIndex(Event const& e) const { return events_.find(e.id); }
+    std::size_t stateCount() const { return states_.size(); }
+    std::size_t eventCount() const { return events_.size(); }
+
+    // Bytes of the cells and the transition records, the part lookups touch
+    std::size_t tableBytes() const
+    {
+        return cells_.size() * sizeof(uint16_t) + transitions_.recordBytes();
+    }
+
+  private:
+    void insert(State& fromState,
+                Event const& onEvent,
+                State& toState,
+                ActionFn action,
+                GuardFn guard,
+                uint16_t flags)
+    {
+        const std::size_t s = states_.insert(fromState.id);
+        const std::size_t e = events_.insert(onEvent.id);
+        const std::size_t to = states_.insert(toState.id);
+        eventSet_.insert(onEvent);
+
+        if (e >= (std::size_t(1) << strideShift_)) {
+            widen();
+        }
+        // Every indexed state has a row, targets included
+        const std::size_t rows = cells_.size() >> strideShift_;
+        if (states_.size() > rows) {
+            cells_.resize(states_.size() << strideShift_, 0);
+        }
+        uint16_t& cell = cells_[(s << strideShift_) + e];
+        // A later transition for the same pair is dropped, see add
+        if (cell == 0) {
+            cell = transitions_.add(to, toState, action, guard, flags);
+        }
+    }
+
+    // Double the row stride and move the existing rows over
+    void widen()
+    {
+        const std::size_t oldStride = std::size_t(1) << strideShift_;
+        const std::size_t rows = cells_.size() >> strideShift_;
+        ++strideShift_;
+        Cells cells(rows << strideShift_, 0, cells_.get_allocator());
+        for (std::size_t r = 0; r < rows; ++r) {
+            for (std::size_t c = 0; c < oldStride; ++c) {
+                cells[(r << strideShift_) + c] = cells_[r * oldStride + c];
+            }
+        }
+        cells_.swap(cells);
+    }
+
+    using Cells = std::vector<uint16_t, Alloc<uint16_t>>;
+
+    DenseIndexT<Alloc<uint32_t>> states_;
+    DenseIndexT<Alloc<uint32_t>> events_;
+    // Row stride is a power of two so the cell index is a shift and an add
+    std::size_t strideShift_{ 3 };
+    // 1 + index into transitions_, 0 for no transition
+    Cells cells_;
+    PackedTransitions<FsmDef, Allocator> transitions_;
+    EventSet eventSet_;
+};
+
+template<typename FsmDef>
+using DenseStateTransitionTableT =
+  BasicDenseStateTransitionTableT<FsmDef, std::allocator<char>>;
+
+template<typename FsmDef>
+using ArenaDenseStateTransitionTableT =
+  BasicDenseStateTransitionTableT<FsmDef, ArenaAllocator<char>>;
+
+} // namespace tsm
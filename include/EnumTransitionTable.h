@@ -0,0 +1,177 @@
+#pragma once
+#include "Arena.h"
+#include "Event.h"
+#include "State.h"
+#include "Transition.h"
+#include "UniqueId.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace tsm {
+
+///
+/// A transition table for machines whose events are an enum, see EnumEvents.
+/// Each state has a row of EnumEvents<E>::COUNT cells, a fixed size array, so
+/// a lookup maps the state id to its dense index, subtracts the enum base
+/// from the event id and reads the cell. The width of a row is a compile-time
+/// constant and there is nothing to widen as events are added.
+///
+/// Select it per machine with EnumTransitionTable:
+/// enum class DoorEvent { Click, SensorHi, Count };
+/// struct MyHsm : Hsm<MyHsm, EnumTransitionTable<DoorEvent>::Table> { ... };
+///
+/// Hsm then only accepts DoorEvent enumerators in add() and handle().
+///
+/// Allocator works as for BasicStateTransitionTableT;
+/// EnumTransitionTable<DoorEvent, ArenaAllocator<char>>::Table builds the
+/// table out of an Arena.
+///
+template<typename FsmDef, typename E, typename Allocator>
+struct BasicEnumStateTransitionTableT
+{
+    template<typename T>
+    using Alloc =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+    using Transition = PackedTransition;
+    using EventSet = std::set<Event, std::less<Event>, Alloc<Event>>;
+    using allocator_type = Allocator;
+    using event_enum = E;
+    static constexpr std::size_t EVENT_COUNT = EnumEvents<E>::COUNT;
+
+  public:
+    BasicEnumStateTransitionTableT() = default;
+
+    explicit BasicEnumStateTransitionTableT(Allocator const& allocator)
+      : states_(Alloc<uint32_t>(allocator))
+      , rows_(Alloc<Row>(allocator))
+      , transitions_(allocator)
+      , eventSet_(Alloc<Event>(allocator))
+    {}
+
+    Transition* next(State& fromState, Event const& onEvent)
+    {
+        const std::size_t s = states_.find(fromState.id);
+        const std::size_t e = EnumEvents<E>::index(onEvent.id);
+        if (s == DenseIndex::NONE || e >= EVENT_COUNT) {
+            return nullptr;
+        }
+        const uint16_t cell = rows_[s][e];
+        return cell == 0 ? nullptr : transitions_.at(cell);
+    }
+
+    bool doTransition(Transition* t, FsmDef* hsm, Event const& e)
+    {
+        return transitions_.doTransition(*t, hsm, e);
+    }
+
+    State& target(Transition const& t) const { return transitions_.target(t); }
+
+    // As with StateTransitionTableT, the first transition added for a
+    // (state, event) pair wins. Events that are not E's are ignored.
+    // Throws std::length_error past PackedTransitions' limits.
+    void add(State& fromState,
+             Event const& onEvent,
+             State& toState,
+             ActionFn action = nullptr,
+             GuardFn guard = nullptr)
+    {
+        insert(fromState, onEvent, toState, action, guard, 0);
+    }
+
+    // A transition that runs action without leaving state; it shares the
+    // cell of (state, event) with add, first one wins
+    void addInternal(State& state,
+                     Event const& onEvent,
+                     ActionFn action = nullptr,
+                     GuardFn guard = nullptr)
+    {
+        insert(
+          state, onEvent, state, action, guard, PackedTransition::INTERNAL);
+    }
+
+    EventSet const& getEvents() const { return eventSet_; }
+
+    // Lookups are already array reads, there is nothing to build.
+    void freeze() {}
+
+    // Dense indices, assigned as in StateTransitionTableT
+    std::size_t stateIndex(State const& s) const { return states_.find(s.id); }
+    std::size_t eventIndex(Event const& ev) const
+    {
+        const std::size_t e = EnumEvents<E>::index(ev.id);
+        // 0 - 1 is NONE for events not in the table
+        return e < EVENT_COUNT ? events_[e] - 1 : DenseIndex::NONE;
+    }
+    std::size_t stateCount() const { return states_.size(); }
+    std::size_t eventCount() const { return eventCount_; }
+
+    // Bytes of the rows and the transition records, the part lookups touch
+    std::size_t tableBytes() const
+    {
+        return rows_.size() * sizeof(Row) + transitions_.recordBytes();
+    }
+
+  private:
+    void insert(State& fromState,
+                Event const& onEvent,
+                State& toState,
+                ActionFn action,
+                GuardFn guard,
+                uint16_t flags)
+    {
+        const std::size_t e = EnumEvents<E>::index(onEvent.id);
+        if (e >= EVENT_COUNT) {
+            LOG(ERROR) << "Event " << onEvent.id << " is not an enum event";
+            return;
+        }
+        const std::size_t s = states_.insert(fromState.id);
+        const std::size_t to = states_.insert(toState.id);
+        if (events_[e] == 0) {
+            events_[e] = ++eventCount_;
+        }
+        eventSet_.insert(onEvent);
+
+        // Every indexed state has a row, targets included
+        if (states_.size() > rows_.size()) {
+            rows_.resize(states_.size(), Row{});
+        }
+        uint16_t& cell = rows_[s][e];
+        // A later transition for the same pair is dropped, see add
+        if (cell == 0) {
+            cell = transitions_.add(to, toState, action, guard, flags);
+        }
+    }
+
+    // 1 + index into transitions_ per event, 0 for no transition
+    using Row = std::array<uint16_t, EVENT_COUNT>;
+
+    DenseIndexT<Alloc<uint32_t>> states_;
+    std::vector<Row, Alloc<Row>> rows_;
+    PackedTransitions<FsmDef, Allocator> transitions_;
+    // 1 + dense index per event, 0 for events not in the table
+    std::array<std::size_t, EVENT_COUNT> events_{};
+    std::size_t eventCount_{};
+    EventSet eventSet_;
+};
+
+template<typename FsmDef, typename E>
+using EnumStateTransitionTableT =
+  BasicEnumStateTransitionTableT<FsmDef, E, std::allocator<char>>;
+
+///
+/// Names the enum table for E as the one-parameter table template Hsm takes.
+///
+template<typename E, typename Allocator = std::allocator<char>>
+struct EnumTransitionTable
+{
+    template<typename FsmDef>
+    using Table = BasicEnumStateTransitionTableT<FsmDef, E, Allocator>;
+};
+
+} // namespace tsm
@@ -1,10 +1,34 @@
 #pragma once
 
+#include <atomic>
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
+#include <cstdlib>
+#include <type_traits>
 namespace tsm {
 
 using event_id_t = uint32_t;
 using event_data_t = uint32_t;
+
+// Ids of enum events start here, well clear of the counter's ids
+constexpr event_id_t ENUM_EVENT_BASE = 0x80000000U;
+
+///
+/// Whether E is an event enum (see EnumEvents): a scoped enum with a Count
+/// enumerator. Plain enums are not, so their constants stay plain ids.
+///
+template<typename E, typename = void>
+struct IsEventEnum : std::false_type
+{};
+
+template<typename E>
+struct IsEventEnum<E, std::conditional_t<true, void, decltype(E::Count)>>
+  : std::integral_constant<bool,
+                           std::is_enum<E>::value &&
+                             !std::is_convertible<E, event_id_t>::value>
+{};
+
 struct Event
 {
 
@@ -23,6 +47,13 @@ struct Event
       : id(id), data(data)
     {}
 
+    // For an enum event, see EnumEvents. Explicit, so enumerators of other
+    // enums (a machine's states, say) do not pass for events unnoticed.
+    template<typename E, typename = std::enable_if_t<IsEventEnum<E>::value>>
+    explicit Event(E e, event_data_t data = 0)
+      : id(ENUM_EVENT_BASE + static_cast<event_id_t>(e)), data(data)
+    {}
+
     bool operator==(const Event& rhs) const { return this->id == rhs.id; }
     bool operator!=(const Event& rhs) const { return !(*this == rhs); }
     bool operator<(const Event& rhs) const { return this->id < rhs.id; }
@@ -30,10 +61,66 @@ struct Event
     event_id_t id;
     event_data_t data;
 
+    // Shared by all threads, like the State id counter. Its ids must stay
+    // below ENUM_EVENT_BASE, or they would alias enum events and then wrap.
     static event_id_t counter_inc() {
-      thread_local event_id_t counter = 0;
-      return ++counter;
+      static std::atomic<event_id_t> counter{ 0 };
+      const event_id_t id = counter.fetch_add(1, std::memory_order_relaxed) + 1;
+      if (id >= ENUM_EVENT_BASE) {
+          assert(false && "Out of Event ids: the counter reached the enum ids");
+          std::abort();
+      }
+      return id;
+    }
+};
+
+///
+/// Events declared as an enum class whose last enumerator is Count:
+///
+/// enum class DoorEvent { Click, SensorHi, Obstruct, Count };
+///
+/// An enumerator converts to an Event with id ENUM_EVENT_BASE + its value, so
+/// the event space of a machine is known at compile time and its tables can
+/// be fixed size arrays indexed by the enumerator, see
+/// EnumStateTransitionTableT. Different enum types share the id range, so a
+/// machine (and the regions of an OrthogonalHsm) should use a single enum.
+///
+template<typename E>
+struct EnumEvents
+{
+    static_assert(std::is_enum<E>::value, "Enum events must be an enum");
+    static constexpr std::size_t COUNT = static_cast<std::size_t>(E::Count);
+    static_assert(COUNT > 0, "Enum events need at least one event");
+
+    static constexpr std::size_t index(E e)
+    {
+        return static_cast<std::size_t>(e);
+    }
+
+    // The index of an Event id, COUNT or more if it is not one of E's
+    static constexpr std::size_t index(event_id_t id)
+    {
+        // Ids below the base wrap around to a large index
+        return static_cast<event_id_t>(id - ENUM_EVENT_BASE);
     }
+
+    static constexpr bool contains(E e) { return index(e) < COUNT; }
+};
+
+///
+/// The enum a table (or a machine) takes its events from: T::event_enum if
+/// it declares one, void if its events are ordinary runtime Events.
+///
+template<typename T, typename = void>
+struct EventEnumOf
+{
+    using type = void;
+};
+
+template<typename T>
+struct EventEnumOf<T, std::conditional_t<true, void, typename T::event_enum>>
+{
+    using type = typename T::event_enum;
 };
 
 ///< For startSM and stopSM calls, the state machine
@@ -1,20 +1,134 @@
 #pragma once
 
+#include "Event.h"
+#include "WaitStrategy.h"
 #include "tsm_log.h"
 
+#include <array>
+#include <atomic>
+#include <bitset>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <deque>
 #include <iostream>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 
 using std::deque;
 
 namespace tsm {
 
+///
+/// What EventQueueT does when a coalescable event is added while another event
+/// with the same id is still pending.
+///
+enum class Coalesce
+{
+    None,        ///< Not coalescable; the event is appended as usual.
+    KeepPending, ///< The new event is dropped; the pending one is kept as is.
+    ReplaceData, ///< The pending event takes the new event's data, in place.
+};
+
+///
+/// Per event id state kept by EventQueueT for its coalescable events. For
+/// events declared as an enum (see EnumEvents) it is a fixed size array
+/// indexed by the enumerator with a bitmap of the coalescable ones, otherwise
+/// a hash map.
+///
+template<typename T, typename EventEnum>
+struct CoalesceMap
+{
+    using Bits = std::bitset<EnumEvents<EventEnum>::COUNT>;
+
+    bool empty() const { return marked_.none(); }
+
+    // The entry for id, nullptr if id is not coalescable
+    T* find(event_id_t id)
+    {
+        const std::size_t e = EnumEvents<EventEnum>::index(id);
+        return e < entries_.size() && marked_[e] ? &entries_[e] : nullptr;
+    }
+
+    // The entry for id, marking it coalescable. nullptr if id is not one of
+    // the enum's events.
+    T* mark(event_id_t id)
+    {
+        const std::size_t e = EnumEvents<EventEnum>::index(id);
+        if (e >= entries_.size()) {
+            return nullptr;
+        }
+        marked_.set(e);
+        return &entries_[e];
+    }
+
+    void erase(event_id_t id)
+    {
+        const std::size_t e = EnumEvents<EventEnum>::index(id);
+        if (e < entries_.size()) {
+            marked_.reset(e);
+            entries_[e] = T{};
+        }
+    }
+
+    template<typename F>
+    void forEach(F f)
+    {
+        for (std::size_t e = 0; e < entries_.size(); ++e) {
+            if (marked_[e]) {
+                f(entries_[e]);
+            }
+        }
+    }
+
+  private:
+    std::array<T, EnumEvents<EventEnum>::COUNT> entries_{};
+    Bits marked_;
+};
+
+template<typename T>
+struct CoalesceMap<T, void>
+{
+    bool empty() const { return entries_.empty(); }
+
+    T* find(event_id_t id)
+    {
+        auto it = entries_.find(id);
+        return it == entries_.end() ? nullptr : &it->second;
+    }
+
+    T* mark(event_id_t id) { return &entries_[id]; }
+
+    void erase(event_id_t id) { entries_.erase(id); }
+
+    template<typename F>
+    void forEach(F f)
+    {
+        for (auto& entry : entries_) {
+            f(entry.second);
+        }
+    }
+
+  private:
+    std::unordered_map<event_id_t, T> entries_;
+};
+
 // A thread safe event queue. Any thread can call addEvent if it has a pointer
-// to the event queue. The call to nextEvent is a blocking call
-template<typename Event, typename LockType>
+// to the event queue. The call to nextEvent is a blocking call. WaitStrategy
+// (see WaitStrategy.h) decides whether the consumer spins for a while before it
+// parks on the condition variable. Producers only notify when a consumer is
+// actually parked.
+//
+// Event ids can be marked coalescable (setCoalescable). Adding such an event
+// while one with the same id is still queued merges the two instead of
+// appending, e.g. so that timer ticks do not pile up behind a slow machine.
+// The check is a hash lookup, not a scan of the queue; with EventEnum, the
+// enum of the machine's events, it is an array read (see CoalesceMap).
+template<typename Event,
+         typename LockType,
+         typename WaitStrategy = BlockingWait,
+         typename EventEnum = void>
 struct EventQueueT : private deque<Event>
 {
     using deque<Event>::empty;
@@ -36,31 +150,95 @@ struct EventQueueT : private deque<Event>
     // Block until you get an event
     Event nextEvent()
     {
+        WaitStrategy::spin([this] { return this->ready(); });
         std::unique_lock<LockType> lock(eventQueueMutex_);
-        cvEventAvailable_.wait(
-          lock, [this] { return (!this->empty() || this->interrupt_); });
+        wait(lock);
         if (interrupt_) {
             return Event();
         }
-        const Event e = std::move(front());
+        const Event e = popFront();
         // LOG(INFO) << "Thread:" << std::this_thread::get_id()
         //          << " Popping Event:" << e.id;
-        pop_front();
+        publishSize();
         return e;
     }
 
-    void addEvent(Event const& e)
+    // Block until at least one event is available, then move up to maxEvents
+    // of them (all pending events if maxEvents is 0) to the back of events
+    // under a single lock acquisition. Returns the number of events taken.
+    std::size_t nextEvents(deque<Event>& events, std::size_t maxEvents = 0)
+    {
+        WaitStrategy::spin([this] { return this->ready(); });
+        std::unique_lock<LockType> lock(eventQueueMutex_);
+        wait(lock);
+        if (interrupt_) {
+            return 0;
+        }
+        std::size_t n = size();
+        if (maxEvents != 0 && maxEvents < n) {
+            n = maxEvents;
+        }
+        if (n == size() && events.empty()) {
+            deque<Event>::swap(events);
+            base_ += static_cast<int64_t>(n);
+            coalescable_.forEach([](Coalescable& c) { c.pending = false; });
+        } else {
+            for (std::size_t i = 0; i < n; ++i) {
+                events.push_back(popFront());
+            }
+        }
+        publishSize();
+        return n;
+    }
+
+    // Returns false if the event was dropped, i.e. it is coalescable with
+    // Coalesce::KeepPending and one with its id is still queued. With
+    // Coalesce::ReplaceData it is merged into the pending event and counts
+    // as queued.
+    bool addEvent(Event const& e)
     {
         std::lock_guard<LockType> lock(eventQueueMutex_);
         // LOG(INFO) << "Thread:" << std::this_thread::get_id()
         //          << " Adding Event:" << e.id;
-        push_back(e);
-        cvEventAvailable_.notify_all();
+        if (!enqueue(e)) {
+            return false;
+        }
+        publishSize();
+        if (sleepers_ != 0) {
+            cvEventAvailable_.notify_all();
+        }
+        return true;
+    }
+
+    // Add a range of events atomically with respect to other producers and
+    // wake the consumer once. Returns the number of events added; events that
+    // coalesced with a pending one are not counted.
+    template<typename InputIt>
+    std::size_t addEvents(InputIt first, InputIt last)
+    {
+        std::lock_guard<LockType> lock(eventQueueMutex_);
+        const std::size_t before = size();
+        if (coalescable_.empty()) {
+            deque<Event>::insert(deque<Event>::end(), first, last);
+        } else {
+            for (; first != last; ++first) {
+                enqueue(*first);
+            }
+        }
+        const std::size_t added = size() - before;
+        publishSize();
+        if (added != 0 && sleepers_ != 0) {
+            cvEventAvailable_.notify_all();
+        }
+        return added;
     }
 
     void stop()
     {
-        interrupt_ = true;
+        {
+            std::lock_guard<LockType> lock(eventQueueMutex_);
+            interrupt_ = true;
+        }
         cvEventAvailable_.notify_all();
         // Log the events that are going to get dumped if the queue is not
         // empty
@@ -72,13 +250,107 @@ struct EventQueueT : private deque<Event>
     {
         std::lock_guard<LockType> lock(eventQueueMutex_);
         push_front(e);
-        cvEventAvailable_.notify_all();
+        --base_;
+        if (!coalescable_.empty()) {
+            Coalescable* c = coalescable_.find(e.id);
+            if (c != nullptr && !c->pending) {
+                c->pending = true;
+                c->index = base_;
+            }
+        }
+        publishSize();
+        if (sleepers_ != 0) {
+            cvEventAvailable_.notify_all();
+        }
+    }
+
+    // Mark events with e's id as coalescable; Coalesce::None undoes it.
+    void setCoalescable(Event const& e, Coalesce mode = Coalesce::ReplaceData)
+    {
+        std::lock_guard<LockType> lock(eventQueueMutex_);
+        if (mode == Coalesce::None) {
+            coalescable_.erase(e.id);
+        } else {
+            Coalescable* c = coalescable_.mark(e.id);
+            if (c != nullptr) {
+                c->mode = mode;
+            }
+        }
     }
 
   private:
+    struct Coalescable
+    {
+        Coalesce mode{ Coalesce::None };
+        bool pending{};
+        // Position of the pending event, counted from the first event ever
+        // queued. Its index in the deque is index - base_.
+        int64_t index{};
+    };
+
+    // Returns false if e was dropped in favour of the pending event
+    bool enqueue(Event const& e)
+    {
+        if (!coalescable_.empty()) {
+            Coalescable* c = coalescable_.find(e.id);
+            if (c != nullptr) {
+                if (c->pending) {
+                    if (c->mode == Coalesce::ReplaceData) {
+                        deque<Event>::operator[](
+                          static_cast<std::size_t>(c->index - base_)) = e;
+                        return true;
+                    }
+                    return false;
+                }
+                c->pending = true;
+                c->index = base_ + static_cast<int64_t>(size());
+            }
+        }
+        push_back(e);
+        return true;
+    }
+
+    Event popFront()
+    {
+        Event e = std::move(front());
+        pop_front();
+        if (!coalescable_.empty()) {
+            Coalescable* c = coalescable_.find(e.id);
+            if (c != nullptr && c->index == base_) {
+                c->pending = false;
+            }
+        }
+        ++base_;
+        return e;
+    }
+
+    // Lock free probe for the wait strategy
+    bool ready() const
+    {
+        return pending_.load(std::memory_order_acquire) != 0 ||
+               interrupt_.load(std::memory_order_acquire);
+    }
+
+    void publishSize() { pending_.store(size(), std::memory_order_release); }
+
+    void wait(std::unique_lock<LockType>& lock)
+    {
+        if (!empty() || interrupt_) {
+            return;
+        }
+        ++sleepers_;
+        cvEventAvailable_.wait(
+          lock, [this] { return (!this->empty() || this->interrupt_); });
+        --sleepers_;
+    }
+
     LockType eventQueueMutex_;
     std::condition_variable_any cvEventAvailable_;
-    bool interrupt_{};
+    std::size_t sleepers_{};
+    CoalesceMap<Coalescable, EventEnum> coalescable_;
+    int64_t base_{};
+    std::atomic<std::size_t> pending_{};
+    std::atomic<bool> interrupt_{};
 };
 
 template<typename Event>
@@ -0,0 +1,356 @@
+#pragma once
+#include "Event.h"
+#include "MachineDefinition.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace tsm {
+
+using instance_id_t = uint32_t;
+
+namespace detail {
+
+// One context per instance, next to the state array
+template<typename Context,
+         typename Allocator,
+         bool = std::is_empty<Context>::value>
+struct FleetContexts
+{
+    FleetContexts() = default;
+    explicit FleetContexts(Allocator const& allocator)
+      : contexts_(allocator)
+    {}
+
+    void reserve(std::size_t n) { contexts_.reserve(n); }
+    void add(Context context) { contexts_.push_back(std::move(context)); }
+    Context& operator[](std::size_t i) { return contexts_[i]; }
+    Context const& operator[](std::size_t i) const { return contexts_[i]; }
+
+  private:
+    std::vector<Context, Allocator> contexts_;
+};
+
+// An empty context has no data to keep apart, so all instances share one
+template<typename Context, typename Allocator>
+struct FleetContexts<Context, Allocator, true>
+{
+    FleetContexts() = default;
+    explicit FleetContexts(Allocator const&) {}
+
+    void reserve(std::size_t) {}
+    void add(Context) {}
+    Context& operator[](std::size_t) { return context_; }
+    Context const& operator[](std::size_t) const { return context_; }
+
+  private:
+    Context context_;
+};
+
+// Lookups Fleet::step does per gather, the width of the widest gather the
+// target has
+#if defined(__AVX512F__)
+constexpr std::size_t STEP_LANES = 16;
+#elif defined(__AVX2__)
+constexpr std::size_t STEP_LANES = 8;
+#else
+constexpr std::size_t STEP_LANES = 4;
+#endif
+
+// out[i] = codes[states[i] * stride + events[i]] for STEP_LANES lanes; lanes
+// whose event is noCell (the machine does not know it) read codes[noCell].
+inline void
+gatherStepCodes(int32_t const* codes,
+                int32_t stride,
+                int32_t noCell,
+                int32_t const* states,
+                int32_t const* events,
+                int32_t* out)
+{
+#if defined(__AVX512F__)
+    const __m512i s = _mm512_loadu_si512(states);
+    const __m512i e = _mm512_loadu_si512(events);
+    const __m512i none = _mm512_set1_epi32(noCell);
+    const __mmask16 known = _mm512_cmpneq_epi32_mask(e, none);
+    const __m512i cell = _mm512_mask_add_epi32(
+      none, known, _mm512_mullo_epi32(s, _mm512_set1_epi32(stride)), e);
+    // The masked form, as GCC warns about the unmasked one's source operand
+    _mm512_storeu_si512(
+      out,
+      _mm512_mask_i32gather_epi32(
+        _mm512_setzero_si512(), 0xFFFF, cell, codes, 4));
+#elif defined(__AVX2__)
+    const __m256i s =
+      _mm256_loadu_si256(reinterpret_cast<__m256i const*>(states));
+    const __m256i e =
+      _mm256_loadu_si256(reinterpret_cast<__m256i const*>(events));
+    const __m256i none = _mm256_set1_epi32(noCell);
+    const __m256i unknown = _mm256_cmpeq_epi32(e, none);
+    const __m256i cell = _mm256_blendv_epi8(
+      _mm256_add_epi32(_mm256_mullo_epi32(s, _mm256_set1_epi32(stride)), e),
+      none,
+      unknown);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out),
+                        _mm256_i32gather_epi32(codes, cell, 4));
+#else
+    for (std::size_t i = 0; i < STEP_LANES; ++i) {
+        out[i] = codes[events[i] == noCell ? noCell
+                                           : states[i] * stride + events[i]];
+    }
+#endif
+}
+
+} // namespace detail
+
+///
+/// Many instances of the flat machine Def (see MachineDefinition), stored as
+/// a struct of arrays: the current state of every instance in one contiguous
+/// array of state indices and, unless Def::Context is empty, the contexts in
+/// another, all sharing Def's definition. There are no per-instance objects,
+/// vtables or allocations, so a million machines with an empty context take
+/// two bytes each, and walking them is a linear scan.
+///
+/// Fleet<DoorDef> doors;
+/// instance_id_t d = doors.add();
+/// doors.dispatch(d, DoorEvent::Click);
+///
+/// Instances are started as they are added and numbered 0, 1, 2... in that
+/// order. A Fleet is not thread safe; dispatch to disjoint instances from
+/// several threads only once no more are being added.
+///
+/// The arrays come from Allocator, rebound as needed; with
+/// ArenaAllocator<char>(arena), or ArenaAllocator<char> in an ArenaScope, the
+/// fleet lives in that Arena. The shared MachineDefinition does not; it is
+/// built once per Def on the heap.
+///
+template<typename Def, typename Allocator = std::allocator<char>>
+struct Fleet
+{
+    template<typename T>
+    using Alloc =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+    using Definition = MachineDefinition<Def>;
+    using Context = typename Def::Context;
+    using States = typename Def::States;
+
+    Fleet() = default;
+
+    explicit Fleet(Allocator const& allocator)
+      : states_(Alloc<state_index_t>(allocator))
+      , contexts_(Alloc<Context>(allocator))
+    {}
+
+    // n instances with default contexts
+    explicit Fleet(std::size_t n, Allocator const& allocator = Allocator())
+      : Fleet(allocator)
+    {
+        reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            add();
+        }
+    }
+
+    void reserve(std::size_t n)
+    {
+        states_.reserve(n);
+        contexts_.reserve(n);
+    }
+
+    // Adds an instance in the initial state, running its entry function
+    instance_id_t add(Context context = Context{})
+    {
+        const auto id = static_cast<instance_id_t>(states_.size());
+        states_.push_back(
+          static_cast<state_index_t>(Definition::index(Def::initial)));
+        contexts_.add(std::move(context));
+        enter(id, tsm::null_event);
+        return id;
+    }
+
+    std::size_t size() const { return states_.size(); }
+
+    // Takes instance id's transition for e, as Machine::handle does. Returns
+    // whether there was one and its guard passed.
+    template<typename E, typename = std::enable_if_t<std::is_enum<E>::value>>
+    bool dispatch(instance_id_t id, E e)
+    {
+        return dispatch(id, Definition::event(e));
+    }
+
+    bool dispatch(instance_id_t id, Event const& e)
+    {
+        Definition const& d = Definition::get();
+        auto const* t = d.next(states_[id], e);
+        if (t == nullptr || !d.passes(*t, contexts_[id], e)) {
+            return false;
+        }
+        if (Definition::isInternal(*t)) {
+            d.act(*t, contexts_[id], e);
+            return true;
+        }
+        leave(id, e);
+        d.act(*t, contexts_[id], e);
+        states_[id] = t->toState;
+        enter(id, e);
+        return true;
+    }
+
+    States getState(instance_id_t id) const
+    {
+        return static_cast<States>(states_[id]);
+    }
+    bool is(instance_id_t id, States s) const
+    {
+        return states_[id] == Definition::index(s);
+    }
+
+    Context& context(instance_id_t id) { return contexts_[id]; }
+    Context const& context(instance_id_t id) const { return contexts_[id]; }
+
+    // The state index of every instance, by instance id
+    state_index_t const* states() const { return states_.data(); }
+
+    // Calls f(id, state, context) for every instance, in id order
+    template<typename F>
+    void forEach(F&& f)
+    {
+        for (std::size_t i = 0; i < states_.size(); ++i) {
+            f(static_cast<instance_id_t>(i),
+              static_cast<States>(states_[i]),
+              contexts_[i]);
+        }
+    }
+
+    ///
+    /// Steps a batch of instances at once: instance ids[i] gets events[i],
+    /// for i < n. The next states are looked up STEP_LANES at a time with a
+    /// vector gather from the definition's step codes (AVX-512 or AVX2 when
+    /// the target has them, e.g. with -march=native, plain loads otherwise).
+    /// Transitions that carry nothing to call are taken by storing the new
+    /// state; only those with an action, guard, exit or entry function go
+    /// through dispatch(). An id may appear more than once: its events are
+    /// taken in order, as a lane whose instance an earlier lane has moved
+    /// goes through dispatch() too. Returns the number of transitions taken.
+    ///
+    std::size_t step(instance_id_t const* ids,
+                     Event const* events,
+                     std::size_t n)
+    {
+        Definition const& d = Definition::get();
+        return stepBatch(
+          ids,
+          n,
+          [&d, events](std::size_t i) {
+              return static_cast<int32_t>(d.eventIndex(events[i]));
+          },
+          [events](std::size_t i) -> Event const& { return events[i]; });
+    }
+
+    template<typename E, typename = std::enable_if_t<std::is_enum<E>::value>>
+    std::size_t step(instance_id_t const* ids, std::size_t n, E e)
+    {
+        return step(ids, n, Definition::event(e));
+    }
+
+    // The same event for every instance in the batch
+    std::size_t step(instance_id_t const* ids, std::size_t n, Event const& e)
+    {
+        const auto event =
+          static_cast<int32_t>(Definition::get().eventIndex(e));
+        return stepBatch(
+          ids,
+          n,
+          [event](std::size_t) { return event; },
+          [&e](std::size_t) -> Event const& { return e; });
+    }
+
+    // The number of instances in state s
+    std::size_t count(States s) const
+    {
+        const auto index = static_cast<state_index_t>(Definition::index(s));
+        std::size_t n = 0;
+        for (state_index_t state : states_) {
+            n += state == index ? 1 : 0;
+        }
+        return n;
+    }
+
+    static Definition const& definition() { return Definition::get(); }
+
+  private:
+    template<typename EventIndex, typename EventAt>
+    std::size_t stepBatch(instance_id_t const* ids,
+                          std::size_t n,
+                          EventIndex eventIndex,
+                          EventAt eventAt)
+    {
+        constexpr std::size_t L = detail::STEP_LANES;
+        Definition const& d = Definition::get();
+        const auto stride = static_cast<int32_t>(d.eventCount());
+        const auto noCell = static_cast<int32_t>(d.noStepCell());
+        int32_t states[L];
+        int32_t events[L];
+        int32_t codes[L];
+        std::size_t taken = 0;
+        for (std::size_t base = 0; base < n; base += L) {
+            const std::size_t lanes = n - base < L ? n - base : L;
+            for (std::size_t i = 0; i < L; ++i) {
+                if (i < lanes) {
+                    states[i] = states_[ids[base + i]];
+                    const int32_t e = eventIndex(base + i);
+                    // DenseIndex::NONE narrows to -1
+                    events[i] = e < 0 ? noCell : e;
+                } else {
+                    states[i] = 0;
+                    events[i] = noCell;
+                }
+            }
+            detail::gatherStepCodes(
+              d.stepCodes(), stride, noCell, states, events, codes);
+            for (std::size_t i = 0; i < lanes; ++i) {
+                const int32_t code = codes[i];
+                // The gather saw the states from before the chunk; an id
+                // repeated in it may have moved since
+                const bool stale = states_[ids[base + i]] != states[i];
+                if (stale || (code & Definition::STEP_CALLBACKS) != 0) {
+                    const Event& e = eventAt(base + i);
+                    taken += dispatch(ids[base + i], e) ? 1 : 0;
+                } else if ((code & Definition::STEP_TRANSITION) != 0) {
+                    states_[ids[base + i]] =
+                      static_cast<state_index_t>(code & Definition::STEP_STATE);
+                    ++taken;
+                }
+            }
+        }
+        return taken;
+    }
+
+    void enter(instance_id_t id, Event const& e)
+    {
+        auto const& entry = Definition::get().entry(states_[id]);
+        if (entry) {
+            entry(contexts_[id], e);
+        }
+    }
+
+    void leave(instance_id_t id, Event const& e)
+    {
+        auto const& exit = Definition::get().exit(states_[id]);
+        if (exit) {
+            exit(contexts_[id], e);
+        }
+    }
+
+    std::vector<state_index_t, Alloc<state_index_t>> states_;
+    detail::FleetContexts<Context, Alloc<Context>> contexts_;
+};
+
+} // namespace tsm
@@ -4,6 +4,10 @@
 #include "State.h"
 #include "Transition.h"
 
+#include <cstddef>
+#include <type_traits>
+#include <unordered_map>
+
 namespace tsm {
 ///
 /// Interface for any Hierarchical State Machine.
@@ -23,7 +27,7 @@ struct IHsm : public State
         currentState_->onEntry(e);
 
         if (parent_ != nullptr) {
-            parent_->setCurrentHsm(this);
+            parent_->onChildEntry(*this);
         }
     }
 
@@ -41,14 +45,19 @@ struct IHsm : public State
             currentState_ = nullptr;
         }
         if (parent_ != nullptr) {
-            parent_->setCurrentHsm(nullptr);
+            parent_->onChildExit(*this);
         }
     }
 
     IHsm* getCurrentHsm() { return currentHsm_; }
     void setCurrentHsm(IHsm* currentHsm) { currentHsm_ = currentHsm; }
 
-    void dispatch(Event const& e)
+    // A sub-Hsm was entered or exited: it becomes, or stops being, the
+    // current sub-Hsm
+    virtual void onChildEntry(IHsm& child) { setCurrentHsm(&child); }
+    virtual void onChildExit(IHsm& /*child*/) { setCurrentHsm(nullptr); }
+
+    virtual void dispatch(Event const& e)
     {
         if (currentHsm_ != nullptr) {
             currentHsm_->dispatch(e);
@@ -71,6 +80,35 @@ struct IHsm : public State
     State* getStopState() { return stopState_; }
     void setStopState(State* s) { stopState_ = s; }
 
+    ///
+    /// Where an event escalated from a descendant ends up: the ancestor that
+    /// owns the transition, the transition as an opaque handle only that
+    /// ancestor understands, and how many levels up it is. See Hsm::compile.
+    ///
+    struct Escalation
+    {
+        IHsm* owner;
+        void* transition;
+        std::size_t depth;
+    };
+    using Escalations = std::unordered_map<event_id_t, Escalation>;
+
+    ///
+    /// Adds to out the transitions this machine takes from child, for events
+    /// not already in out, and returns whether escalations may be looked up
+    /// past this machine. The default is opaque: nothing is added and the
+    /// search stops here, so such events keep going through handle().
+    ///
+    virtual bool collectEscalations(State& /*child*/,
+                                    std::size_t /*depth*/,
+                                    Escalations& /*out*/)
+    {
+        return false;
+    }
+
+    // Takes a transition handed out by collectEscalations
+    virtual void fire(void* /*transition*/, Event const& /*e*/) {}
+
   private:
     IHsm* parent_;
     IHsm* currentHsm_{};
@@ -82,18 +120,62 @@ struct IHsm : public State
 };
 
 ///
-/// Implements a Hierarchical State Machine.
+/// Whether transition table T has addInternal, i.e. internal transitions
 ///
-template<typename HsmDef>
+template<typename T, typename = void>
+struct HasInternalTransitions : std::false_type
+{};
+
+template<typename T>
+struct HasInternalTransitions<
+  T,
+  std::conditional_t<true, void, decltype(&T::addInternal)>> : std::true_type
+{};
+
+///
+/// Implements a Hierarchical State Machine. The transition table type can be
+/// swapped out, e.g. for a DenseStateTransitionTableT for small machines.
+///
+template<typename HsmDef,
+         template<typename> class TransitionTableType = StateTransitionTableT>
 struct Hsm : public IHsm
 {
-    using StateTransitionTable = StateTransitionTableT<HsmDef>;
-    using Transition = typename StateTransitionTableT<HsmDef>::Transition;
+    using StateTransitionTable = TransitionTableType<HsmDef>;
+    using Transition = typename StateTransitionTable::Transition;
+    // The enum of this machine's events, void unless its table has one
+    using event_enum = typename EventEnumOf<StateTransitionTable>::type;
 
     explicit Hsm(IHsm* parent = nullptr)
       : IHsm(parent)
     {}
 
+    // Builds the table with allocator, e.g. ArenaAllocator<char>(arena) for
+    // an ArenaStateTransitionTableT
+    template<typename Allocator,
+             typename = std::enable_if_t<
+               !std::is_convertible<Allocator, IHsm*>::value &&
+               std::is_constructible<StateTransitionTable,
+                                     Allocator const&>::value>>
+    explicit Hsm(Allocator const& allocator, IHsm* parent = nullptr)
+      : IHsm(parent)
+      , table_(allocator)
+    {}
+
+    // The transitions are all added by now, so freeze the table for lookup.
+    void onEntry(Event const& e) override
+    {
+        table_.freeze();
+        IHsm::onEntry(e);
+    }
+
+    // An enum event; it must be one of this machine's if it has an event enum
+    template<typename E, typename = std::enable_if_t<std::is_enum<E>::value>>
+    void handle(E e, event_data_t data = 0)
+    {
+        static_assert(acceptsEnum<E>(), "Not one of this machine's events");
+        handle(Event(e, data));
+    }
+
     void handle(Event const& nextEvent) override
     {
         Transition* t = this->next(*this->currentState_, nextEvent);
@@ -102,6 +184,14 @@ struct Hsm : public IHsm
             
             bool consumed = this->getCurrentState()->execute(nextEvent);
 
+            if (!consumed && !escalations_.empty()) {
+                auto it = escalations_.find(nextEvent.id);
+                if (it != escalations_.end()) {
+                    escalate(it->second, nextEvent);
+                    return;
+                }
+            }
+
             if(!consumed) {
                 // If transition does not exist, pass event to parent Hsm
                 if (this->getParent() != nullptr) {
@@ -115,17 +205,57 @@ struct Hsm : public IHsm
             }
 
         } else {
+            take(t, nextEvent);
+        }
+    }
 
-            // Perform entry and exit actions in the doTransition function.
-            // If just an internal transition, Entry and exit actions are
-            // not performed
-            t->doTransition(static_cast<HsmDef*>(this), nextEvent);
+    ///
+    /// Optional: precomputes where events this machine does not handle end
+    /// up, so that handle() reaches the ancestor's transition with one more
+    /// lookup however deep the hierarchy is, instead of one lookup per
+    /// level. While this machine is active each ancestor Hsm is in the state
+    /// that is its child on the path down to here, so the transition an
+    /// ancestor takes for an event is fixed and can be found up front.
+    ///
+    /// The execute() calls that handle() makes on the way up are still made,
+    /// in the same order, so states that consume events that way behave the
+    /// same. The search stops at an ancestor that is not an Hsm (e.g. an
+    /// OrthogonalHsm); events handled from there up take the usual path.
+    ///
+    /// Call it once all the machines in the hierarchy have their
+    /// transitions, and again on each compiled machine if any of them
+    /// change. It freezes this machine's table too.
+    ///
+    void compile()
+    {
+        table_.freeze();
+        escalations_.clear();
+        State* child = this;
+        std::size_t depth = 1;
+        for (IHsm* p = this->getParent();
+             p != nullptr && p->collectEscalations(*child, depth, escalations_);
+             child = p, p = p->getParent(), ++depth) {
+        }
+    }
 
-            if (this->currentState_ == this->getStopState()) {
-                // LOG(INFO) << this->id << " Reached stop state. Exiting.";
-                this->onExit(tsm::null_event);
+    bool collectEscalations(State& child,
+                            std::size_t depth,
+                            Escalations& out) override
+    {
+        for (auto const& e : getEvents()) {
+            if (out.count(e.id) == 0) {
+                Transition* t = this->next(child, e);
+                if (t != nullptr) {
+                    out.emplace(e.id, Escalation{ this, t, depth });
+                }
             }
         }
+        return true;
+    }
+
+    void fire(void* transition, Event const& e) override
+    {
+        take(static_cast<Transition*>(transition), e);
     }
 
     void add(State& fromState,
@@ -137,15 +267,139 @@ struct Hsm : public IHsm
         table_.add(fromState, onEvent, toState, action, guard);
     }
 
+    template<typename E, typename = std::enable_if_t<std::is_enum<E>::value>>
+    void add(State& fromState,
+             E onEvent,
+             State& toState,
+             ActionFn action = nullptr,
+             GuardFn guard = nullptr)
+    {
+        static_assert(acceptsEnum<E>(), "Not one of this machine's events");
+        table_.add(fromState, Event(onEvent), toState, action, guard);
+    }
+
+    // A transition that runs action without leaving state, no exit or entry.
+    // Only for tables of PackedTransitions, like DenseStateTransitionTableT.
+    template<typename Table = StateTransitionTable>
+    void addInternal(State& state,
+                     Event const& onEvent,
+                     ActionFn action = nullptr,
+                     GuardFn guard = nullptr)
+    {
+        static_assert(HasInternalTransitions<Table>::value,
+                      "addInternal needs a table with internal transitions, "
+                      "like DenseStateTransitionTableT or EnumTransitionTable");
+        addInternalTo(table_,
+                      state,
+                      onEvent,
+                      action,
+                      guard,
+                      HasInternalTransitions<Table>{});
+    }
+
+    template<typename E, typename = std::enable_if_t<std::is_enum<E>::value>>
+    void addInternal(State& state,
+                     E onEvent,
+                     ActionFn action = nullptr,
+                     GuardFn guard = nullptr)
+    {
+        static_assert(acceptsEnum<E>(), "Not one of this machine's events");
+        addInternal(state, Event(onEvent), action, guard);
+    }
+
     Transition* next(State& currentState, Event const& nextEvent)
     {
         return table_.next(currentState, nextEvent);
     }
 
-    StateTransitionTable& getTable() const { return table_; }
-    std::set<Event> const& getEvents() const { return table_.getEvents(); }
+    StateTransitionTable& getTable() { return table_; }
+    void freeze() { table_.freeze(); }
+    auto const& getEvents() const { return table_.getEvents(); }
+
+    ///
+    /// Dense indices for this machine's states and events, 0, 1, 2... in the
+    /// order add() first sees them. A machine type adds its transitions in
+    /// the same order in every instance, so the indices are the same for all
+    /// instances on any thread, and can index per-state or per-event side
+    /// data in plain arrays. DenseIndex::NONE for states and events that are
+    /// not in the table.
+    ///
+    std::size_t stateIndex(State const& s) const
+    {
+        return table_.stateIndex(s);
+    }
+    std::size_t eventIndex(Event const& e) const
+    {
+        return table_.eventIndex(e);
+    }
+    template<typename E, typename = std::enable_if_t<std::is_enum<E>::value>>
+    std::size_t eventIndex(E e) const
+    {
+        static_assert(acceptsEnum<E>(), "Not one of this machine's events");
+        return table_.eventIndex(Event(e));
+    }
+    std::size_t stateCount() const { return table_.stateCount(); }
+    std::size_t eventCount() const { return table_.eventCount(); }
 
   protected:
+    template<typename E>
+    static constexpr bool acceptsEnum()
+    {
+        return std::is_void<event_enum>::value ||
+               std::is_same<E, event_enum>::value;
+    }
+
+    // Perform entry and exit actions in the doTransition function.
+    // If just an internal transition, Entry and exit actions are
+    // not performed
+    void take(Transition* t, Event const& nextEvent)
+    {
+        table_.doTransition(t, static_cast<HsmDef*>(this), nextEvent);
+
+        if (this->currentState_ == this->getStopState()) {
+            // LOG(INFO) << this->id << " Reached stop state. Exiting.";
+            this->onExit(tsm::null_event);
+        }
+    }
+
+    // The levels between here and the owner get the same execute() calls
+    // that escalating through handle() would make.
+    void escalate(Escalation const& x, Event const& nextEvent)
+    {
+        IHsm* level = this;
+        for (std::size_t i = 1; i < x.depth; ++i) {
+            if (level->execute(nextEvent)) {
+                return;
+            }
+            level = level->getParent();
+        }
+        x.owner->fire(x.transition, nextEvent);
+    }
+
     StateTransitionTable table_;
+
+  private:
+    template<typename Table>
+    static void addInternalTo(Table& table,
+                              State& state,
+                              Event const& onEvent,
+                              ActionFn& action,
+                              GuardFn& guard,
+                              std::true_type /*supported*/)
+    {
+        table.addInternal(state, onEvent, action, guard);
+    }
+
+    // Not supported; addInternal has already failed its static_assert
+    template<typename Table>
+    static void addInternalTo(Table&,
+                              State&,
+                              Event const&,
+                              ActionFn&,
+                              GuardFn&,
+                              std::false_type /*supported*/)
+    {}
+
+    Escalations escalations_;
 };
 } // namespace tsm
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace tsm {
+
+template<typename Signature, std::size_t Capacity = 3 * sizeof(void*)>
+class InlineFunction;
+
+namespace detail {
+
+template<typename Fn, typename Signature, typename = void>
+struct IsCallableAs : std::false_type
+{};
+
+// Fn can be called with Args and its result converts to R (or R is void)
+template<typename Fn, typename R, typename... Args>
+struct IsCallableAs<
+  Fn,
+  R(Args...),
+  std::enable_if_t<
+    std::is_void<R>::value ||
+    std::is_convertible<decltype(std::declval<Fn&>()(std::declval<Args>()...)),
+                        R>::value>> : std::true_type
+{};
+
+// Empty function pointers and std::functions make an empty InlineFunction,
+// as they do a std::function
+template<typename Fn>
+bool
+isNullCallable(Fn const& /*unused*/)
+{
+    return false;
+}
+
+template<typename R, typename... Args>
+bool
+isNullCallable(R (*f)(Args...))
+{
+    return f == nullptr;
+}
+
+template<typename Signature>
+bool
+isNullCallable(std::function<Signature> const& f)
+{
+    return !f;
+}
+
+} // namespace detail
+
+///
+/// A copyable callable wrapper like std::function, but callables of up to
+/// Capacity bytes, like most lambdas capturing pointers or references, are
+/// stored inline and never allocate. Larger callables (a std::function, a
+/// lambda capturing a std::string, ...) still work; they are kept on the
+/// heap as std::function would. Calling it is one indirect call through a
+/// function pointer, and trivially copyable inline callables are copied
+/// with a plain memberwise copy. Calling an empty InlineFunction asserts.
+///
+/// Member functions are bound with InlineFunction::bind(object, &T::method).
+///
+template<typename R, typename... Args, std::size_t Capacity>
+class InlineFunction<R(Args...), Capacity>
+{
+  public:
+    InlineFunction() noexcept = default;
+
+    InlineFunction(std::nullptr_t) noexcept {}
+
+    template<typename F,
+             typename Fn = std::decay_t<F>,
+             typename = std::enable_if_t<
+               !std::is_same<Fn, InlineFunction>::value &&
+               !std::is_same<Fn, std::nullptr_t>::value &&
+               detail::IsCallableAs<Fn, R(Args...)>::value>>
+    InlineFunction(F&& f)
+    {
+        if (detail::isNullCallable(f)) {
+            return;
+        }
+        // Trivial callables are copied as the whole buffer, so the bytes the
+        // callable does not use must not be left uninitialized
+        ::new (static_cast<void*>(&storage_)) Storage();
+        store<Fn>(std::forward<F>(f), IsInline<Fn>{});
+    }
+
+    template<typename T>
+    static InlineFunction bind(T* object, R (T::*method)(Args...))
+    {
+        return [object, method](Args... args) -> R {
+            return (object->*method)(std::forward<Args>(args)...);
+        };
+    }
+
+    InlineFunction(InlineFunction const& other) { copyFrom(other); }
+
+    InlineFunction(InlineFunction&& other) noexcept { moveFrom(other); }
+
+    InlineFunction& operator=(InlineFunction const& other)
+    {
+        if (this != &other) {
+            reset();
+            copyFrom(other);
+        }
+        return *this;
+    }
+
+    InlineFunction& operator=(InlineFunction&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    InlineFunction& operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    ~InlineFunction() { reset(); }
+
+    explicit operator bool() const noexcept { return invoke_ != nullptr; }
+
+    R operator()(Args... args) const
+    {
+        assert(invoke_ != nullptr && "Calling an empty InlineFunction");
+        return invoke_(&storage_, std::forward<Args>(args)...);
+    }
+
+  private:
+    enum class Op
+    {
+        Copy,
+        Move,
+        Destroy
+    };
+
+    using Storage =
+      typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type;
+    using Invoker = R (*)(void*, Args&&...);
+    using Manager = void (*)(Op, void*, void*);
+
+    // Stored in the buffer, or on the heap with a pointer in the buffer.
+    // Inline callables must not throw when moved, so moves cannot throw.
+    template<typename Fn>
+    using IsInline =
+      std::integral_constant<bool,
+                             sizeof(Fn) <= Capacity &&
+                               alignof(Fn) <= alignof(std::max_align_t) &&
+                               std::is_nothrow_move_constructible<Fn>::value>;
+
+    template<typename Fn, typename F>
+    void store(F&& f, std::true_type /*inline*/)
+    {
+        ::new (static_cast<void*>(&storage_)) Fn(std::forward<F>(f));
+        invoke_ = &invoke<Fn>;
+        if (!std::is_trivially_copyable<Fn>::value ||
+            !std::is_trivially_destructible<Fn>::value) {
+            manage_ = &manage<Fn>;
+        }
+    }
+
+    template<typename Fn, typename F>
+    void store(F&& f, std::false_type /*inline*/)
+    {
+        ::new (static_cast<void*>(&storage_)) Fn*(new Fn(std::forward<F>(f)));
+        invoke_ = &invokeHeap<Fn>;
+        manage_ = &manageHeap<Fn>;
+    }
+
+    template<typename Fn>
+    static R invoke(void* f, Args&&... args)
+    {
+        return (*static_cast<Fn*>(f))(std::forward<Args>(args)...);
+    }
+
+    template<typename Fn>
+    static R invokeHeap(void* f, Args&&... args)
+    {
+        return (**static_cast<Fn**>(f))(std::forward<Args>(args)...);
+    }
+
+    // Copies, moves or destroys non-trivial inline callables; trivial ones
+    // need none of it.
+    template<typename Fn>
+    static void manage(Op op, void* dst, void* src)
+    {
+        switch (op) {
+            case Op::Copy:
+                ::new (dst) Fn(*static_cast<Fn const*>(src));
+                break;
+            case Op::Move:
+                ::new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+                static_cast<Fn*>(src)->~Fn();
+                break;
+            case Op::Destroy:
+                static_cast<Fn*>(dst)->~Fn();
+                break;
+        }
+    }
+
+    // A move only hands the pointer over
+    template<typename Fn>
+    static void manageHeap(Op op, void* dst, void* src)
+    {
+        switch (op) {
+            case Op::Copy:
+                ::new (dst) Fn*(new Fn(**static_cast<Fn* const*>(src)));
+                break;
+            case Op::Move:
+                ::new (dst) Fn*(*static_cast<Fn**>(src));
+                break;
+            case Op::Destroy:
+                delete *static_cast<Fn**>(dst);
+                break;
+        }
+    }
+
+    void copyFrom(InlineFunction const& other)
+    {
+        if (other.manage_ != nullptr) {
+            other.manage_(Op::Copy, &storage_, &other.storage_);
+        } else if (other.invoke_ != nullptr) {
+            storage_ = other.storage_;
+        }
+        invoke_ = other.invoke_;
+        manage_ = other.manage_;
+    }
+
+    // Leaves other empty
+    void moveFrom(InlineFunction& other) noexcept
+    {
+        if (other.manage_ != nullptr) {
+            other.manage_(Op::Move, &storage_, &other.storage_);
+        } else if (other.invoke_ != nullptr) {
+            storage_ = other.storage_;
+        }
+        invoke_ = other.invoke_;
+        manage_ = other.manage_;
+        other.invoke_ = nullptr;
+        other.manage_ = nullptr;
+    }
+
+    void reset() noexcept
+    {
+        if (manage_ != nullptr) {
+            manage_(Op::Destroy, &storage_, nullptr);
+        }
+        invoke_ = nullptr;
+        manage_ = nullptr;
+    }
+
+    mutable Storage storage_;
+    Invoker invoke_{};
+    Manager manage_{};
+};
+
+} // namespace tsm
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "WaitStrategy.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace tsm {
+
+///
+/// A lock-free multi-producer/single-consumer event queue. It is a drop-in
+/// replacement for EventQueueT when plugged into AsyncExecutionPolicy:
+/// nextEvent, addEvent and stop have the same semantics.
+///
+/// Producers never take a lock. Each addEvent links a node with a single
+/// atomic exchange (an intrusive Vyukov style queue). The consumer only parks
+/// on a condition variable when the queue is empty, and producers only touch
+/// the mutex when they see that the consumer is parked.
+///
+/// WaitStrategy (see WaitStrategy.h) lets the consumer spin for a while
+/// before it parks.
+///
+/// Only one thread may call nextEvent at any time.
+///
+template<typename Event, typename WaitStrategy = BlockingWait>
+struct LockFreeEventQueueT
+{
+  public:
+    LockFreeEventQueueT()
+      : head_(&stub_)
+      , tail_(&stub_)
+    {}
+    LockFreeEventQueueT(LockFreeEventQueueT const&) = delete;
+    LockFreeEventQueueT(LockFreeEventQueueT&&) = delete;
+    LockFreeEventQueueT operator=(LockFreeEventQueueT const&) = delete;
+    LockFreeEventQueueT operator=(LockFreeEventQueueT&&) = delete;
+
+    ~LockFreeEventQueueT()
+    {
+        stop();
+        Event e{ 0 };
+        while (tryPop(e)) {
+        }
+    }
+
+    // Block until you get an event
+    Event nextEvent()
+    {
+        // A placeholder with a fixed id: Event() would take a new id from the
+        // shared counter, a contended atomic, on every call
+        Event e{ 0 };
+        while (!interrupt_.load(std::memory_order_acquire)) {
+            if (tryPop(e)) {
+                return e;
+            }
+            if (WaitStrategy::spin([this] {
+                    return this->linked() ||
+                           this->interrupt_.load(std::memory_order_acquire);
+                })) {
+                continue;
+            }
+            // Announce that we are about to park, then look again. A
+            // producer either sees consumerWaiting_ or we see its node.
+            consumerWaiting_.store(true, std::memory_order_seq_cst);
+            if (tryPop(e)) {
+                consumerWaiting_.store(false, std::memory_order_relaxed);
+                return e;
+            }
+            std::unique_lock<std::mutex> lock(parkMutex_);
+            cvEventAvailable_.wait(lock, [this] {
+                return this->linked() ||
+                       this->interrupt_.load(std::memory_order_acquire);
+            });
+            consumerWaiting_.store(false, std::memory_order_relaxed);
+        }
+        return e;
+    }
+
+    // Block until at least one event is available, then move up to maxEvents
+    // of them (all linked events if maxEvents is 0) to the back of events.
+    // Returns the number of events taken.
+    std::size_t nextEvents(std::deque<Event>& events, std::size_t maxEvents = 0)
+    {
+        Event e = nextEvent();
+        if (interrupted()) {
+            return 0;
+        }
+        events.push_back(e);
+        std::size_t n = 1;
+        while ((maxEvents == 0 || n < maxEvents) && tryPop(e)) {
+            events.push_back(e);
+            ++n;
+        }
+        return n;
+    }
+
+    bool addEvent(Event const& e)
+    {
+        Node* node = new Node(e);
+        push(node, node);
+        wakeConsumer();
+        return true;
+    }
+
+    // Link a range of events privately and publish it with a single atomic
+    // exchange, so the range stays contiguous with respect to other
+    // producers. Wakes the consumer once. Returns the number of events added.
+    template<typename InputIt>
+    std::size_t addEvents(InputIt first, InputIt last)
+    {
+        if (first == last) {
+            return 0;
+        }
+        Node* head = new Node(*first);
+        Node* tail = head;
+        std::size_t n = 1;
+        for (++first; first != last; ++first, ++n) {
+            Node* node = new Node(*first);
+            tail->next.store(node, std::memory_order_relaxed);
+            tail = node;
+        }
+        push(head, tail);
+        wakeConsumer();
+        return n;
+    }
+
+    void stop()
+    {
+        interrupt_.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(parkMutex_);
+        cvEventAvailable_.notify_all();
+    }
+
+    bool interrupted() { return interrupt_.load(std::memory_order_acquire); }
+
+  private:
+    struct Node
+    {
+        Node() = default;
+        explicit Node(Event const& e)
+          : event(e)
+        {}
+        std::atomic<Node*> next{};
+        Event event{ 0 };
+    };
+
+    // Producers: swing head_ to the new node and link the old head to it.
+    void push(Node* first, Node* last)
+    {
+        last->next.store(nullptr, std::memory_order_relaxed);
+        Node* prev = head_.exchange(last, std::memory_order_acq_rel);
+        prev->next.store(first, std::memory_order_seq_cst);
+    }
+
+    void wakeConsumer()
+    {
+        if (consumerWaiting_.load(std::memory_order_seq_cst)) {
+            std::lock_guard<std::mutex> lock(parkMutex_);
+            cvEventAvailable_.notify_one();
+        }
+    }
+
+    // Consumer only. True once a producer has linked a node behind tail_,
+    // i.e. when tryPop can make progress.
+    bool linked() const
+    {
+        return tail_->next.load(std::memory_order_seq_cst) != nullptr;
+    }
+
+    // Consumer only. The stub node is recycled to the back of the queue
+    // whenever the consumer catches up with the producers.
+    bool tryPop(Event& e)
+    {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (next == nullptr) {
+                return false;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next != nullptr) {
+            tail_ = next;
+            e = tail->event;
+            delete tail;
+            return true;
+        }
+        // tail is the last linked node. If a producer is half way through
+        // push, wait for it to finish linking rather than report empty.
+        if (tail != head_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        push(&stub_, &stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            tail_ = next;
+            e = tail->event;
+            delete tail;
+            return true;
+        }
+        return false;
+    }
+
+    std::atomic<Node*> head_;
+    Node* tail_;
+    Node stub_;
+
+    std::mutex parkMutex_;
+    std::condition_variable cvEventAvailable_;
+    std::atomic<bool> consumerWaiting_{};
+    std::atomic<bool> interrupt_{};
+};
+
+template<typename Event>
+using LockFreeEventQueue = LockFreeEventQueueT<Event>;
+
+} // namespace tsm
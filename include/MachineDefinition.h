@@ -0,0 +1,385 @@
+#pragma once
+#include "Event.h"
+#include "InlineFunction.h"
+#include "Transition.h"
+#include "UniqueId.h"
+#include "tsm_log.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tsm {
+
+using state_index_t = uint16_t;
+
+///
+/// The shared, immutable part of a flat state machine: its states, events,
+/// transitions and the entry, exit, action and guard functions, which are
+/// bound to a context type instead of to an instance. It is built once per
+/// machine type, on first use, and shared by all the instances of that type,
+/// see Machine. Def describes the machine:
+///
+/// enum class DoorState { Closed, Opening, Open, Count };
+/// struct Door { int opened{}; };
+/// struct DoorDef {
+///     using Context = Door;
+///     using States = DoorState;
+///     static constexpr DoorState initial = DoorState::Closed;
+///     static void define(MachineDefinition<DoorDef>& d) {
+///         d.add(DoorState::Closed, DoorEvent::Click, DoorState::Opening);
+///         d.add(DoorState::Opening, DoorEvent::SensorHi, DoorState::Open,
+///               [](Door& door, Event const&) { ++door.opened; });
+///     }
+/// };
+///
+/// States are an enum class whose last enumerator is Count, like enum events
+/// (see EnumEvents); events are any Events. Transitions are found in a flat
+/// [state][event] array of transition positions, as in
+/// DenseStateTransitionTableT, and as there the first transition added for a
+/// (state, event) pair wins; later ones are dropped. Transition positions are
+/// 16 bits, so add throws std::length_error after MAX_TRANSITIONS adds.
+///
+template<typename Def>
+struct MachineDefinition
+{
+    using Context = typename Def::Context;
+    using States = typename Def::States;
+    using Action = InlineFunction<void(Context&, Event const&)>;
+    using Guard = InlineFunction<bool(Context&, Event const&)>;
+
+    static constexpr std::size_t STATE_COUNT =
+      static_cast<std::size_t>(States::Count);
+    static_assert(STATE_COUNT > 0, "A machine needs at least one state");
+    static_assert(STATE_COUNT <= UINT16_MAX, "Too many states");
+
+    // As PackedTransition, with the actions and guards in side tables here
+    using Transition = PackedTransition;
+    static constexpr std::size_t MAX_TRANSITIONS = UINT16_MAX;
+
+    // Bits of a step code, see stepCodes
+    static constexpr int32_t STEP_STATE = 0xFFFF;
+    static constexpr int32_t STEP_TRANSITION = 1 << 16;
+    static constexpr int32_t STEP_CALLBACKS = 1 << 17;
+
+    // The definition of Def, built by Def::define the first time it is asked
+    // for. Thread safe; it is never changed afterwards.
+    static MachineDefinition const& get()
+    {
+        static const MachineDefinition definition = [] {
+            MachineDefinition d;
+            Def::define(d);
+            d.seal();
+            return d;
+        }();
+        return definition;
+    }
+
+    // Only for Def::define
+    void add(States fromState,
+             Event const& onEvent,
+             States toState,
+             Action action = nullptr,
+             Guard guard = nullptr)
+    {
+        insert(fromState, onEvent, toState, action, guard, 0);
+    }
+
+    // A transition that runs action without leaving state, no exit or entry
+    void addInternal(States state,
+                     Event const& onEvent,
+                     Action action = nullptr,
+                     Guard guard = nullptr)
+    {
+        insert(
+          state, onEvent, state, action, guard, PackedTransition::INTERNAL);
+    }
+
+    template<typename E, typename = std::enable_if_t<std::is_enum<E>::value>>
+    void add(States fromState,
+             E onEvent,
+             States toState,
+             Action action = nullptr,
+             Guard guard = nullptr)
+    {
+        add(fromState, event(onEvent), toState, action, guard);
+    }
+
+    template<typename E, typename = std::enable_if_t<std::is_enum<E>::value>>
+    void addInternal(States state,
+                     E onEvent,
+                     Action action = nullptr,
+                     Guard guard = nullptr)
+    {
+        addInternal(state, event(onEvent), action, guard);
+    }
+
+    // The Event of an enumerator of an event enum (see EnumEvents), which
+    // must not be the machine's States
+    template<typename E>
+    static Event event(E e)
+    {
+        static_assert(IsEventEnum<E>::value,
+                      "Not an event enum: a scoped enum with a Count");
+        static_assert(!std::is_same<E, States>::value,
+                      "A state is not an event");
+        return Event(e);
+    }
+
+    void onEntry(States s, Action action) { entry_[index(s)] = action; }
+    void onExit(States s, Action action) { exit_[index(s)] = action; }
+
+    // The transition from state on e, nullptr if there is none
+    Transition const* next(std::size_t state, Event const& e) const
+    {
+        const std::size_t ev = events_.find(e.id);
+        if (ev == DenseIndex::NONE) {
+            return nullptr;
+        }
+        const uint16_t cell = cells_[state * events_.size() + ev];
+        return cell == 0 ? nullptr : &transitions_[cell - 1];
+    }
+
+    ///
+    /// The transitions as one 32 bit code per [state][event] cell, for
+    /// gathering many lookups at once (see Fleet::step): 0 if there is no
+    /// transition, else STEP_TRANSITION, the target state in the STEP_STATE
+    /// bits and STEP_CALLBACKS if taking it calls anything, i.e. it has an
+    /// action or guard, or its source has an exit or its target an entry
+    /// function. There is one more cell past the last row, always 0, for
+    /// events the machine does not know; see noStepCell.
+    ///
+    int32_t const* stepCodes() const { return codes_.data(); }
+    std::size_t noStepCell() const { return codes_.size() - 1; }
+
+    // Whether t's guard, if any, passes
+    bool passes(Transition const& t, Context& context, Event const& e) const
+    {
+        return t.guard == 0 || guards_[t.guard - 1](context, e);
+    }
+
+    void act(Transition const& t, Context& context, Event const& e) const
+    {
+        if (t.action != 0) {
+            actions_[t.action - 1](context, e);
+        }
+    }
+
+    static bool isInternal(Transition const& t)
+    {
+        return (t.flags & PackedTransition::INTERNAL) != 0;
+    }
+
+    Action const& entry(std::size_t s) const { return entry_[s]; }
+    Action const& exit(std::size_t s) const { return exit_[s]; }
+
+    static constexpr std::size_t index(States s)
+    {
+        return static_cast<std::size_t>(s);
+    }
+
+    // Dense event index, in the order add() first saw the events
+    std::size_t eventIndex(Event const& e) const { return events_.find(e.id); }
+    std::size_t eventCount() const { return events_.size(); }
+    std::size_t transitionCount() const { return transitions_.size(); }
+
+    // Bytes of the cells and the transition records, the part lookups touch
+    std::size_t tableBytes() const
+    {
+        return cells_.size() * sizeof(uint16_t) +
+               transitions_.size() * sizeof(Transition);
+    }
+    std::set<Event> const& getEvents() const { return eventSet_; }
+
+  private:
+    MachineDefinition() = default;
+
+    void insert(States fromState,
+                Event const& onEvent,
+                States toState,
+                Action const& action,
+                Guard const& guard,
+                uint16_t flags)
+    {
+        if (sealed_) {
+            LOG(ERROR) << "Machine definitions cannot change once built";
+            return;
+        }
+        if (index(fromState) >= STATE_COUNT || index(toState) >= STATE_COUNT) {
+            LOG(ERROR) << "Count is not a state";
+            return;
+        }
+        // Counts every add, dropped ones included; actions and guards are
+        // never more
+        if (transitions_.size() >= MAX_TRANSITIONS) {
+            throw std::length_error("Too many transitions for a machine");
+        }
+        const std::size_t e = events_.insert(onEvent.id);
+        eventSet_.insert(onEvent);
+        added_.push_back(Added{ index(fromState), e });
+        Transition t{ static_cast<uint16_t>(index(toState)), 0, 0, flags };
+        if (action) {
+            actions_.push_back(action);
+            t.action = static_cast<uint16_t>(actions_.size());
+        }
+        if (guard) {
+            guards_.push_back(guard);
+            t.guard = static_cast<uint16_t>(guards_.size());
+        }
+        transitions_.push_back(t);
+    }
+
+    struct Added
+    {
+        std::size_t fromState;
+        std::size_t event;
+    };
+
+    // Lays the transitions out now that the number of events is known
+    void seal()
+    {
+        cells_.assign(STATE_COUNT * events_.size(), 0);
+        std::vector<Transition> kept;
+        for (std::size_t i = 0; i < added_.size(); ++i) {
+            uint16_t& cell =
+              cells_[added_[i].fromState * events_.size() + added_[i].event];
+            // The first transition for the pair wins
+            if (cell == 0) {
+                kept.push_back(transitions_[i]);
+                cell = static_cast<uint16_t>(kept.size());
+            }
+        }
+        transitions_.swap(kept);
+
+        codes_.assign(cells_.size() + 1, 0);
+        for (std::size_t c = 0; c < cells_.size(); ++c) {
+            if (cells_[c] == 0) {
+                continue;
+            }
+            Transition const& t = transitions_[cells_[c] - 1];
+            const std::size_t from = c / events_.size();
+            const bool callbacks =
+              t.action != 0 || t.guard != 0 ||
+              (!isInternal(t) && (exit_[from] || entry_[t.toState]));
+            codes_[c] = STEP_TRANSITION | t.toState |
+                        (callbacks ? STEP_CALLBACKS : 0);
+        }
+        added_.clear();
+        added_.shrink_to_fit();
+        sealed_ = true;
+    }
+
+    DenseIndex events_;
+    // Row stride is the number of events; 1 + index into transitions_, 0 for
+    // no transition
+    std::vector<uint16_t> cells_;
+    std::vector<Transition> transitions_;
+    std::vector<Action> actions_;
+    std::vector<Guard> guards_;
+    std::vector<int32_t> codes_;
+    Action entry_[STATE_COUNT];
+    Action exit_[STATE_COUNT];
+    std::set<Event> eventSet_;
+    // Only while Def::define runs
+    std::vector<Added> added_;
+    bool sealed_{};
+};
+
+template<typename Def>
+constexpr std::size_t MachineDefinition<Def>::MAX_TRANSITIONS;
+template<typename Def>
+constexpr int32_t MachineDefinition<Def>::STEP_STATE;
+template<typename Def>
+constexpr int32_t MachineDefinition<Def>::STEP_TRANSITION;
+template<typename Def>
+constexpr int32_t MachineDefinition<Def>::STEP_CALLBACKS;
+
+///
+/// An instance of the flat machine Def (see MachineDefinition). All it holds
+/// is the current state and its Def::Context; the transitions are in the
+/// definition shared by every instance, so constructing one builds nothing.
+///
+/// It is driven directly, not through an execution policy:
+/// Machine<DoorDef> door;
+/// door.startSM();
+/// door.handle(DoorEvent::Click);
+///
+template<typename Def>
+struct Machine
+{
+    using Definition = MachineDefinition<Def>;
+    using Context = typename Def::Context;
+    using States = typename Def::States;
+
+    explicit Machine(Context context = Context{})
+      : context_(std::move(context))
+    {}
+
+    void startSM()
+    {
+        current_ = static_cast<state_index_t>(Definition::index(Def::initial));
+        enter(tsm::null_event);
+    }
+
+    void stopSM() { leave(tsm::null_event); }
+
+    template<typename E, typename = std::enable_if_t<std::is_enum<E>::value>>
+    bool handle(E e)
+    {
+        return handle(Definition::event(e));
+    }
+
+    // Takes the transition for e from the current state, if there is one and
+    // its guard passes. Returns whether it did.
+    bool handle(Event const& e)
+    {
+        Definition const& d = Definition::get();
+        auto const* t = d.next(current_, e);
+        if (t == nullptr || !d.passes(*t, context_, e)) {
+            return false;
+        }
+        if (Definition::isInternal(*t)) {
+            d.act(*t, context_, e);
+            return true;
+        }
+        leave(e);
+        d.act(*t, context_, e);
+        current_ = t->toState;
+        enter(e);
+        return true;
+    }
+
+    States getCurrentState() const { return static_cast<States>(current_); }
+    bool is(States s) const { return current_ == Definition::index(s); }
+
+    Context& context() { return context_; }
+    Context const& context() const { return context_; }
+
+    static Definition const& definition() { return Definition::get(); }
+
+  private:
+    void enter(Event const& e)
+    {
+        auto const& entry = Definition::get().entry(current_);
+        if (entry) {
+            entry(context_, e);
+        }
+    }
+
+    void leave(Event const& e)
+    {
+        auto const& exit = Definition::get().exit(current_);
+        if (exit) {
+            exit(context_, e);
+        }
+    }
+
+    Context context_;
+    state_index_t current_{};
+};
+
+} // namespace tsm
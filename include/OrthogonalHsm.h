@@ -2,10 +2,21 @@
 
 #include "Event.h"
 #include "Hsm.h"
+#include "InlineFunction.h"
 #include "State.h"
+#include "ThreadPoolExecutor.h"
+#include "UniqueId.h"
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <tuple>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
 
 namespace tsm {
@@ -61,43 +72,431 @@ perform(Tuple&& tuple, size_t index, Action action)
       });
 }
 
+///
+/// The regions of an OrthogonalHsm map event ids to bitmasks of regions. When
+/// every region takes its events from the same enum (see EnumEvents) the map
+/// is a fixed size array indexed by the enumerator, otherwise a hash map.
+///
+template<typename E>
+struct RegionRoutes
+{
+    void clear() { masks_.fill(0); }
+    void add(event_id_t id, uint32_t regions)
+    {
+        const std::size_t e = EnumEvents<E>::index(id);
+        if (e < EnumEvents<E>::COUNT) {
+            masks_[e] |= regions;
+        }
+    }
+    // The regions that have id, 0 for none
+    uint32_t find(event_id_t id) const
+    {
+        const std::size_t e = EnumEvents<E>::index(id);
+        return e < EnumEvents<E>::COUNT ? masks_[e] : 0;
+    }
+
+  private:
+    std::array<uint32_t, EnumEvents<E>::COUNT> masks_{};
+};
+
+template<>
+struct RegionRoutes<void>
+{
+    void clear() { masks_.clear(); }
+    void add(event_id_t id, uint32_t regions) { masks_[id] |= regions; }
+    uint32_t find(event_id_t id) const
+    {
+        auto it = masks_.find(id);
+        return it == masks_.end() ? 0 : it->second;
+    }
+
+  private:
+    std::unordered_map<event_id_t, uint32_t> masks_;
+};
+
+// The event enum all of Hsms share, void if they do not all have the same one
+template<typename Hsm, typename... Hsms>
+struct CommonEventEnum
+{
+    using type = typename EventEnumOf<Hsm>::type;
+};
+
+template<typename Hsm, typename Next, typename... Hsms>
+struct CommonEventEnum<Hsm, Next, Hsms...>
+{
+    using first = typename EventEnumOf<Hsm>::type;
+    using type = std::conditional_t<
+      std::is_same<first,
+                   typename CommonEventEnum<Next, Hsms...>::type>::value,
+      first,
+      void>;
+};
+
+///
+/// How OrthogonalHsm delivers an event that several regions know about.
+///
+enum class RegionDelivery
+{
+    // Only the first region, in template argument order, gets it
+    First,
+    // Every region that has it gets it, in template argument order, like UML
+    // orthogonal regions
+    Broadcast,
+};
+
+///
+/// Runs several regions (Hsms) side by side. An event goes to the first
+/// region, in template argument order, whose transition table has it, or to
+/// all of them with setDelivery(RegionDelivery::Broadcast).
+///
+/// The regions are found through a routing table built at construction that
+/// maps each event id to a bitmask of the regions that know it, so routing
+/// an event is one hash lookup and an indirect call, whatever the number of
+/// regions. If all the regions share an event enum the lookup is an array
+/// read instead, see RegionRoutes. Call buildRoutes() again if a region's
+/// transitions change after construction.
+///
+/// Events that no region's table has go to the current sub-Hsm, which is how
+/// the events of a region's own sub-Hsms get there. If the chosen region
+/// cannot handle an event in its current state, the event goes up to this
+/// machine's parent, as events do from any Hsm; when broadcasting, it goes up
+/// once, and only if none of the regions it was delivered to handled it.
+///
+/// With setExecutor, a broadcast event is delivered to its regions in
+/// parallel: see setExecutor.
+///
 template<typename... Hsms>
 struct OrthogonalHsm : public IHsm
 {
     using type = OrthogonalHsm<Hsms...>;
     static constexpr size_t HSM_COUNT = sizeof...(Hsms);
+    static_assert(HSM_COUNT <= 32, "At most 32 regions");
 
     OrthogonalHsm()
     {
         for_each_hsm(sms_, [&](auto& sm) { sm.setParent(this); });
         this->setCurrentHsm(&std::get<0>(sms_));
         for_each_hsm(sms_, [&](auto& sm) { sm.onEntry(tsm::null_event); });
+        buildRoutes();
     }
 
-    void handle(Event const& nextEvent) override
+    // The helper tasks point back here, so wait for any still queued
+    ~OrthogonalHsm() override
     {
-        // Get the first hsm that handles the event
-        auto sm_index = find_if(sms_, [&](auto& hsm) {
-            auto supported_events = hsm.getEvents();
-            auto event_it = supported_events.find(nextEvent);
-            return (event_it != supported_events.end());
-        });
-        if (sm_index < HSM_COUNT) {
-            perform(sms_, sm_index, [&](auto& sm) { sm.dispatch(nextEvent); });
-        } else {
-            // Try sending the event up to parent
-            if (this->getParent()) {
-                // Don't dispatch, directly handle here.
-                this->getParent()->handle(nextEvent);
-            } else {
-                LOG(ERROR) << "Reached top level Hsm. Cannot handle event";
+        if (parallel_) {
+            Parallel& p = *parallel_;
+            std::unique_lock<std::mutex> lock(p.latchMutex);
+            p.latch.wait(lock, [&p] { return p.queued == 0; });
+        }
+    }
+
+    void buildRoutes()
+    {
+        routes_.clear();
+        events_.clear();
+        uint32_t bit = 1;
+        for_each_hsm(sms_, [&](auto& sm) {
+            for (auto const& e : sm.getEvents()) {
+                routes_.add(e.id, bit);
+                events_.insert(e);
             }
+            bit <<= 1;
+        });
+    }
+
+    void setDelivery(RegionDelivery delivery) { delivery_ = delivery; }
+    RegionDelivery getDelivery() const { return delivery_; }
+
+    ///
+    /// Deliver broadcast events to their regions concurrently, using
+    /// executor's workers (a ThreadPoolExecutor, WorkStealingExecutor, ...)
+    /// as well as the calling thread. Each region is claimed and run by
+    /// exactly one thread, so a region still sees its events one at a time
+    /// and in order; there is no ordering between regions. The event is
+    /// finished, and escalated if every region declined it, only once all
+    /// its regions are done, so run-to-completion holds for the
+    /// OrthogonalHsm.
+    ///
+    /// Regions must not share state that their actions change. A region
+    /// entered or exited during the event becomes, or stops being, the
+    /// current sub-Hsm once all are done, in template argument order as when
+    /// delivering on one thread. The calling
+    /// thread runs whatever regions the workers have not picked up and only
+    /// waits for those they have, so it is fine to broadcast from one of
+    /// executor's own workers. Helper tasks that start late find nothing to
+    /// do; the OrthogonalHsm waits for them when destroyed, so the executor
+    /// must still be running then. Call before startSM; setExecutor(nullptr)
+    /// goes back to delivering on the calling thread. The tasks and the
+    /// latch are only allocated by the first setExecutor.
+    ///
+    template<typename Executor>
+    void setExecutor(Executor* executor)
+    {
+        if (executor == nullptr) {
+            setExecutor(nullptr);
+            return;
+        }
+        if (!parallel_) {
+            parallel_ = std::make_unique<Parallel>(this);
+        }
+        parallel_->schedule = [executor](Runnable* r) {
+            executor->schedule(r);
+        };
+    }
+
+    // Keeps the tasks, as some may still be queued
+    void setExecutor(std::nullptr_t)
+    {
+        if (parallel_) {
+            parallel_->schedule = nullptr;
+        }
+    }
+
+    // Regions running in parallel leave the current sub-Hsm alone; their
+    // entries and exits are applied when the event is done, see setExecutor
+    void onChildEntry(IHsm& child) override
+    {
+        if (!defer(child, RegionChange::Entry)) {
+            IHsm::onChildEntry(child);
         }
     }
 
+    void onChildExit(IHsm& child) override
+    {
+        if (!defer(child, RegionChange::Exit)) {
+            IHsm::onChildExit(child);
+        }
+    }
+
+    // Routes the event to its region. Events no region's table has, like
+    // those of a region's sub-Hsms, go down the current sub-Hsm as usual.
+    void dispatch(Event const& nextEvent) override
+    {
+        if (!route(nextEvent)) {
+            IHsm::dispatch(nextEvent);
+        }
+    }
+
+    void handle(Event const& nextEvent) override
+    {
+        // While the event is being delivered, handle() is only reached by a
+        // region escalating it.
+        if (routing_) {
+            declined_.fetch_add(1, std::memory_order_relaxed);
+        } else if (!route(nextEvent)) {
+            escalate(nextEvent);
+        }
+    }
+
+    // The events of all the regions
+    std::set<Event> const& getEvents() const { return events_; }
+
     State* getCurrentState() override { return this->getCurrentHsm(); }
 
     State* getStartState() override { return &std::get<0>(sms_); }
     std::tuple<Hsms...> sms_;
+
+  private:
+    bool route(Event const& nextEvent)
+    {
+        uint32_t regions = routes_.find(nextEvent.id);
+        if (regions == 0) {
+            return false;
+        }
+        if (delivery_ == RegionDelivery::First) {
+            regions &= ~regions + 1;
+        }
+        std::size_t delivered = 0;
+        for (uint32_t r = regions; r != 0; r &= r - 1) {
+            ++delivered;
+        }
+        routing_ = true;
+        declined_.store(0, std::memory_order_relaxed);
+        if (parallel_ && parallel_->schedule && delivered > 1) {
+            deliverInParallel(nextEvent, regions, delivered);
+        } else {
+            for (; regions != 0; regions &= regions - 1) {
+                dispatchers()[lowestSetBit(regions)](*this, nextEvent);
+            }
+        }
+        routing_ = false;
+        if (declined_.load(std::memory_order_relaxed) == delivered) {
+            escalate(nextEvent);
+        }
+        return true;
+    }
+
+    // Hands delivered - 1 helper tasks to the executor and claims regions on
+    // this thread too, then waits for the regions other threads claimed.
+    // Helpers that have not started by then find nothing left to claim, so
+    // the event never waits on a task queued behind this thread.
+    void deliverInParallel(Event const& nextEvent,
+                           uint32_t regions,
+                           std::size_t delivered)
+    {
+        Parallel& p = *parallel_;
+        // A copy, as the caller's event may not outlive the worker tasks
+        p.current = nextEvent;
+        p.delivering = true;
+        p.unclaimed.store(regions, std::memory_order_release);
+        for (std::size_t i = 0; i + 1 < delivered; ++i) {
+            // A task still queued from an earlier event helps with this one
+            // when it runs; it is not queued twice.
+            {
+                std::lock_guard<std::mutex> lock(p.latchMutex);
+                if (p.tasks[i].queued) {
+                    continue;
+                }
+                p.tasks[i].queued = true;
+                ++p.queued;
+            }
+            p.schedule(&p.tasks[i]);
+        }
+        claimRegions();
+        {
+            std::unique_lock<std::mutex> lock(p.latchMutex);
+            p.latch.wait(lock, [&p] { return p.claiming == 0; });
+        }
+        p.delivering = false;
+
+        std::size_t i = 0;
+        for_each_hsm(sms_, [&](auto& sm) {
+            if (p.changes[i] == RegionChange::Entry) {
+                IHsm::onChildEntry(sm);
+            } else if (p.changes[i] == RegionChange::Exit) {
+                IHsm::onChildExit(sm);
+            }
+            p.changes[i++] = RegionChange::None;
+        });
+    }
+
+    // Runs regions of the current event until none are left to claim
+    void claimRegions()
+    {
+        Parallel& p = *parallel_;
+        uint32_t left = p.unclaimed.load(std::memory_order_acquire);
+        while (left != 0) {
+            const uint32_t bit = left & (~left + 1);
+            left = p.unclaimed.fetch_and(~bit, std::memory_order_acq_rel);
+            if ((left & bit) != 0) {
+                dispatchers()[lowestSetBit(bit)](*this, p.current);
+            }
+            left &= ~bit;
+        }
+    }
+
+    enum class RegionChange : uint8_t
+    {
+        None,
+        Entry,
+        Exit
+    };
+
+    // Records child's entry or exit if it is a region running in parallel.
+    // Each region is run by one thread, so each slot has a single writer.
+    bool defer(IHsm& child, RegionChange change)
+    {
+        if (!parallel_ || !parallel_->delivering) {
+            return false;
+        }
+        const std::size_t region = find_if(sms_, [&child](auto const& sm) {
+            return static_cast<IHsm const*>(&sm) == &child;
+        });
+        if (region == HSM_COUNT) {
+            return false;
+        }
+        parallel_->changes[region] = change;
+        return true;
+    }
+
+    struct RegionTask : public Runnable
+    {
+        void run() override
+        {
+            Parallel& p = *owner->parallel_;
+            // Counted before claiming, so the delivering thread cannot see
+            // every region claimed while this one is still running it
+            {
+                std::lock_guard<std::mutex> lock(p.latchMutex);
+                ++p.claiming;
+            }
+            owner->claimRegions();
+            std::lock_guard<std::mutex> lock(p.latchMutex);
+            queued = false;
+            --p.queued;
+            --p.claiming;
+            p.latch.notify_all();
+        }
+
+        OrthogonalHsm* owner{};
+        // Handed to the executor and not returned yet, under latchMutex
+        bool queued{};
+    };
+
+    // Parallel delivery, see setExecutor
+    struct Parallel
+    {
+        explicit Parallel(OrthogonalHsm* owner)
+        {
+            for (auto& task : tasks) {
+                task.owner = owner;
+            }
+        }
+
+        InlineFunction<void(Runnable*)> schedule;
+        RegionTask tasks[HSM_COUNT];
+        Event current{ 0 };
+        // Set by the delivering thread while the regions run
+        bool delivering{};
+        // Regions of the current event no thread has claimed yet
+        std::atomic<uint32_t> unclaimed{};
+        // Each region's entry or exit during the current event
+        std::array<RegionChange, HSM_COUNT> changes{};
+        std::mutex latchMutex;
+        std::condition_variable latch;
+        // Helper tasks running claimRegions, and those not returned yet
+        std::size_t claiming{};
+        std::size_t queued{};
+    };
+
+    void escalate(Event const& nextEvent)
+    {
+        // Try sending the event up to parent
+        if (this->getParent()) {
+            // Don't dispatch, directly handle here.
+            this->getParent()->handle(nextEvent);
+        } else {
+            LOG(ERROR) << "Reached top level Hsm. Cannot handle event";
+        }
+    }
+
+    using Dispatcher = void (*)(OrthogonalHsm&, Event const&);
+
+    template<std::size_t I>
+    static void dispatchTo(OrthogonalHsm& self, Event const& e)
+    {
+        std::get<I>(self.sms_).dispatch(e);
+    }
+
+    template<std::size_t... I>
+    static Dispatcher const* dispatchers(std::index_sequence<I...> /*unused*/)
+    {
+        static constexpr Dispatcher table[] = { &dispatchTo<I>... };
+        return table;
+    }
+
+    static Dispatcher const* dispatchers()
+    {
+        return dispatchers(std::make_index_sequence<HSM_COUNT>{});
+    }
+
+    // Event id to the bitmask of regions whose tables have it
+    RegionRoutes<typename CommonEventEnum<Hsms...>::type> routes_;
+    std::set<Event> events_;
+    RegionDelivery delivery_{ RegionDelivery::First };
+    bool routing_{};
+    // Regions that escalated the event being delivered
+    std::atomic<std::size_t> declined_{};
+    std::unique_ptr<Parallel> parallel_;
 };
 } // namespace tsm
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "Event.h"
+#include "ThreadPoolExecutor.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace tsm {
+
+///
+/// An execution policy that runs the state machine on a shared executor
+/// instead of a thread of its own, actor style. Events sent to the machine
+/// go to its mailbox. The first event into an empty mailbox schedules the
+/// machine on the executor, and a worker then dispatches the pending events.
+/// A machine is scheduled at most once at a time, so its events are still
+/// processed one after the other (run-to-completion) and in the order they
+/// were sent. An idle machine is just its mailbox; it uses no thread.
+///
+/// Events sent before startSM wait in the mailbox until the machine starts.
+/// After batchSize events the machine gives the worker back and is
+/// rescheduled, so a busy machine cannot starve the others on the pool.
+///
+/// The executor must outlive the machine. ExecutorType needs a single
+/// schedule(Runnable*) method, see ThreadPoolExecutor.
+///
+template<typename StateType, typename ExecutorType = ThreadPoolExecutor>
+struct PooledExecutionPolicy
+  : public StateType
+  , public Runnable
+{
+    explicit PooledExecutionPolicy(ExecutorType& executor)
+      : executor_(executor)
+    {}
+
+    PooledExecutionPolicy(PooledExecutionPolicy const&) = delete;
+    PooledExecutionPolicy operator=(PooledExecutionPolicy const&) = delete;
+    PooledExecutionPolicy(PooledExecutionPolicy&&) = delete;
+    PooledExecutionPolicy operator=(PooledExecutionPolicy&&) = delete;
+
+    virtual ~PooledExecutionPolicy() { waitUntilReleased(); }
+
+    void onEntry(Event const& e) override
+    {
+        StateType::onEntry(e);
+        bool schedule = false;
+        {
+            std::lock_guard<std::mutex> lock(mailboxMutex_);
+            running_ = true;
+            stopped_ = false;
+            if (!mailbox_.empty() && !scheduled_) {
+                scheduled_ = schedule = true;
+            }
+        }
+        onIdle();
+        if (schedule) {
+            executor_.schedule(this);
+        }
+    }
+
+    // Pending events are dropped.
+    void onExit(Event const& e) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mailboxMutex_);
+            running_ = false;
+            stopped_ = true;
+            mailbox_.clear();
+        }
+        StateType::onExit(e);
+    }
+
+    // Returns false if the machine has been stopped.
+    bool sendEvent(Event const& event)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mailboxMutex_);
+            if (stopped_) {
+                return false;
+            }
+            mailbox_.push_back(event);
+            if (!running_ || scheduled_) {
+                return true;
+            }
+            scheduled_ = true;
+        }
+        executor_.schedule(this);
+        return true;
+    }
+
+    template<typename InputIt>
+    std::size_t sendEvents(InputIt first, InputIt last)
+    {
+        std::size_t n = 0;
+        {
+            std::lock_guard<std::mutex> lock(mailboxMutex_);
+            if (stopped_) {
+                return 0;
+            }
+            for (; first != last; ++first, ++n) {
+                mailbox_.push_back(*first);
+            }
+            if (n == 0 || !running_ || scheduled_) {
+                return n;
+            }
+            scheduled_ = true;
+        }
+        executor_.schedule(this);
+        return n;
+    }
+
+    // Events dispatched per turn on a worker; 0 drains the mailbox.
+    void setBatchSize(std::size_t batchSize) { batchSize_ = batchSize; }
+    std::size_t getBatchSize() const { return batchSize_; }
+
+    ExecutorType& getExecutor() { return executor_; }
+
+    void run() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mailboxMutex_);
+            std::size_t n = mailbox_.size();
+            if (batchSize_ != 0 && batchSize_ < n) {
+                n = batchSize_;
+            }
+            for (std::size_t i = 0; i < n; ++i) {
+                batch_.push_back(mailbox_.front());
+                mailbox_.pop_front();
+            }
+        }
+        for (; !batch_.empty(); batch_.pop_front()) {
+            // An event in the batch may have stopped the state machine
+            if (!running_) {
+                batch_.clear();
+                break;
+            }
+            StateType::dispatch(batch_.front());
+        }
+
+        if (!hasWork()) {
+            onIdle();
+            std::lock_guard<std::mutex> lock(mailboxMutex_);
+            if (mailbox_.empty() || !running_) {
+                scheduled_ = false;
+                cvIdle_.notify_all();
+                return;
+            }
+        }
+        executor_.schedule(this);
+    }
+
+  protected:
+    // Called on the worker whenever the mailbox runs dry
+    virtual void onIdle() {}
+
+    // Stop the machine and wait for a worker that is running it to let go of
+    // it. Must be called by the destructor of the most derived class that
+    // overrides onIdle, before its members are destroyed.
+    void waitUntilReleased()
+    {
+        std::unique_lock<std::mutex> lock(mailboxMutex_);
+        running_ = false;
+        stopped_ = true;
+        mailbox_.clear();
+        cvIdle_.wait(lock, [this] { return !this->scheduled_; });
+    }
+
+    bool hasWork()
+    {
+        std::lock_guard<std::mutex> lock(mailboxMutex_);
+        return !mailbox_.empty() && running_;
+    }
+
+    ExecutorType& executor_;
+    std::mutex mailboxMutex_;
+    std::condition_variable cvIdle_;
+    std::deque<Event> mailbox_;
+    std::deque<Event> batch_;
+    std::size_t batchSize_{ 16 };
+    bool scheduled_{};
+    std::atomic<bool> running_{};
+    bool stopped_{};
+};
+
+///
+/// A pooled execution policy that invokes the Observer's notify method every
+/// time the machine has processed all the events in its mailbox, and once
+/// after startSM.
+///
+template<typename StateType,
+         typename Observer,
+         typename ExecutorType = ThreadPoolExecutor>
+struct PooledExecWithObserver
+  : public PooledExecutionPolicy<StateType, ExecutorType>
+  , public Observer
+{
+    using Observer::notify;
+
+    explicit PooledExecWithObserver(ExecutorType& executor)
+      : PooledExecutionPolicy<StateType, ExecutorType>(executor)
+      , Observer()
+    {}
+
+    ~PooledExecWithObserver() override { this->waitUntilReleased(); }
+
+  protected:
+    void onIdle() override { notify(); }
+};
+
+} // namespace tsm
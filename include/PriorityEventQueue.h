@@ -0,0 +1,240 @@
+#pragma once
+
+#include "UniqueId.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace tsm {
+
+///
+/// Lane names for the default four lane PriorityEventQueue. Lower lanes are
+/// served first.
+///
+enum class EventPriority : std::size_t
+{
+    Control = 0,
+    Urgent = 1,
+    Normal = 2,
+    Bulk = 3,
+};
+
+///
+/// A thread safe event queue with a small, fixed number of FIFO priority
+/// lanes. nextEvent always takes from the highest priority (lowest numbered)
+/// non-empty lane, found from a bitmask of non-empty lanes, so both enqueue
+/// and dequeue are O(1) no matter how deep the backlog in the other lanes is.
+///
+/// Events are routed to a lane by event id (setPriority); events without a
+/// registered lane go to the default lane. With a starvation limit, a
+/// non-empty lane that has been passed over that many times is served next.
+///
+/// It can be plugged into AsyncExecutionPolicy as its EventQueueType.
+///
+template<typename Event, typename LockType, std::size_t Lanes = 4>
+struct PriorityEventQueueT
+{
+    static_assert(Lanes > 0 && Lanes <= 32, "Between 1 and 32 lanes");
+
+    using IdType = decltype(Event::id);
+
+  public:
+    PriorityEventQueueT() = default;
+    PriorityEventQueueT(PriorityEventQueueT const&) = delete;
+    PriorityEventQueueT(PriorityEventQueueT&&) = delete;
+    PriorityEventQueueT operator=(PriorityEventQueueT const&) = delete;
+    PriorityEventQueueT operator=(PriorityEventQueueT&&) = delete;
+
+    ~PriorityEventQueueT() { stop(); }
+
+    // Send every event with e's id to lane.
+    void setPriority(Event const& e, std::size_t lane)
+    {
+        std::lock_guard<LockType> lock(eventQueueMutex_);
+        laneOf_[e.id] = clamp(lane);
+    }
+
+    void setPriority(Event const& e, EventPriority priority)
+    {
+        setPriority(e, static_cast<std::size_t>(priority));
+    }
+
+    // Lane for events without a registered priority
+    void setDefaultLane(std::size_t lane)
+    {
+        std::lock_guard<LockType> lock(eventQueueMutex_);
+        defaultLane_ = clamp(lane);
+    }
+
+    // Serve a non-empty lane once it has been passed over limit times in a
+    // row. 0, the default, means strict priority.
+    void setStarvationLimit(std::size_t limit)
+    {
+        std::lock_guard<LockType> lock(eventQueueMutex_);
+        starvationLimit_ = limit;
+    }
+
+    // Block until you get an event
+    Event nextEvent()
+    {
+        std::unique_lock<LockType> lock(eventQueueMutex_);
+        cvEventAvailable_.wait(
+          lock, [this] { return (this->nonEmpty_ != 0 || this->interrupt_); });
+        if (interrupt_) {
+            return Event();
+        }
+        return pop();
+    }
+
+    // Block until at least one event is available, then move up to maxEvents
+    // of them (all pending events if maxEvents is 0), in priority order, to
+    // the back of events under a single lock acquisition.
+    std::size_t nextEvents(std::deque<Event>& events, std::size_t maxEvents = 0)
+    {
+        std::unique_lock<LockType> lock(eventQueueMutex_);
+        cvEventAvailable_.wait(
+          lock, [this] { return (this->nonEmpty_ != 0 || this->interrupt_); });
+        if (interrupt_) {
+            return 0;
+        }
+        std::size_t n = 0;
+        while (nonEmpty_ != 0 && (maxEvents == 0 || n < maxEvents)) {
+            events.push_back(pop());
+            ++n;
+        }
+        return n;
+    }
+
+    bool addEvent(Event const& e)
+    {
+        std::lock_guard<LockType> lock(eventQueueMutex_);
+        push(e, laneFor(e));
+        cvEventAvailable_.notify_all();
+        return true;
+    }
+
+    // Bypass the registered priority and add e to lane.
+    bool addEvent(Event const& e, std::size_t lane)
+    {
+        std::lock_guard<LockType> lock(eventQueueMutex_);
+        push(e, clamp(lane));
+        cvEventAvailable_.notify_all();
+        return true;
+    }
+
+    bool addEvent(Event const& e, EventPriority priority)
+    {
+        return addEvent(e, static_cast<std::size_t>(priority));
+    }
+
+    template<typename InputIt>
+    std::size_t addEvents(InputIt first, InputIt last)
+    {
+        std::lock_guard<LockType> lock(eventQueueMutex_);
+        std::size_t n = 0;
+        for (; first != last; ++first, ++n) {
+            push(*first, laneFor(*first));
+        }
+        if (n != 0) {
+            cvEventAvailable_.notify_all();
+        }
+        return n;
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<LockType> lock(eventQueueMutex_);
+            interrupt_ = true;
+        }
+        cvEventAvailable_.notify_all();
+    }
+
+    bool interrupted() { return interrupt_; }
+
+    std::size_t size()
+    {
+        std::lock_guard<LockType> lock(eventQueueMutex_);
+        std::size_t n = 0;
+        for (auto const& lane : lanes_) {
+            n += lane.size();
+        }
+        return n;
+    }
+
+  private:
+    static std::size_t clamp(std::size_t lane)
+    {
+        return lane < Lanes ? lane : Lanes - 1;
+    }
+
+    std::size_t laneFor(Event const& e) const
+    {
+        if (laneOf_.empty()) {
+            return defaultLane_;
+        }
+        auto it = laneOf_.find(e.id);
+        return it == laneOf_.end() ? defaultLane_ : it->second;
+    }
+
+    void push(Event const& e, std::size_t lane)
+    {
+        lanes_[lane].push_back(e);
+        nonEmpty_ |= (1U << lane);
+    }
+
+    std::size_t selectLane()
+    {
+        std::size_t lane = lowestSetBit(nonEmpty_);
+        if (starvationLimit_ != 0) {
+            // Every non-empty lane below the one about to be served has been
+            // passed over once more.
+            uint32_t waiting = nonEmpty_ & ~((2U << lane) - 1);
+            std::size_t starved = Lanes;
+            while (waiting != 0) {
+                std::size_t l = lowestSetBit(waiting);
+                waiting &= waiting - 1;
+                if (++skipped_[l] > starvationLimit_ && starved == Lanes) {
+                    starved = l;
+                }
+            }
+            if (starved != Lanes) {
+                lane = starved;
+            }
+        }
+        skipped_[lane] = 0;
+        return lane;
+    }
+
+    Event pop()
+    {
+        const std::size_t lane = selectLane();
+        auto& q = lanes_[lane];
+        const Event e = std::move(q.front());
+        q.pop_front();
+        if (q.empty()) {
+            nonEmpty_ &= ~(1U << lane);
+        }
+        return e;
+    }
+
+    LockType eventQueueMutex_;
+    std::condition_variable_any cvEventAvailable_;
+    std::deque<Event> lanes_[Lanes];
+    uint32_t nonEmpty_{};
+    std::size_t skipped_[Lanes]{};
+    std::size_t starvationLimit_{};
+    std::size_t defaultLane_{ Lanes > 2 ? 2 : Lanes - 1 };
+    std::unordered_map<IdType, std::size_t> laneOf_;
+    std::atomic<bool> interrupt_{};
+};
+
+template<typename Event>
+using PriorityEventQueue = PriorityEventQueueT<Event, std::mutex>;
+
+} // namespace tsm
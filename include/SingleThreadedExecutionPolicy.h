@@ -2,6 +2,7 @@
 
 #include "Event.h"
 
+#include <cstddef>
 #include <deque>
 
 ///
@@ -31,6 +32,15 @@ struct SingleThreadedExecutionPolicy : public StateType
 
     void sendEvent(Event const& event) { eventQueue_.push_back(event); }
 
+    // Queue a range of events in order. Returns the number of events queued.
+    template<typename InputIt>
+    std::size_t sendEvents(InputIt first, InputIt last)
+    {
+        const std::size_t before = eventQueue_.size();
+        eventQueue_.insert(eventQueue_.end(), first, last);
+        return eventQueue_.size() - before;
+    }
+
   private:
     EventQueue eventQueue_;
     bool interrupt_{};
@@ -0,0 +1,435 @@
+#pragma once
+
+#include "Event.h"
+#include "Hsm.h"
+#include "State.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <type_traits>
+
+namespace tsm {
+
+// The default Row action: nothing to do
+struct NoAction
+{
+    template<typename Fsm>
+    void operator()(Fsm&, Event const&) const
+    {}
+};
+
+// The default Row guard: always passes
+struct NoGuard
+{
+    template<typename Fsm>
+    bool operator()(Fsm&, Event const&) const
+    {
+        return true;
+    }
+};
+
+///
+/// A compile-time transition table for machines whose structure is known up
+/// front. States and events are types and the table is a type list of Rows:
+///
+/// struct Idle {}; struct Running {};
+/// struct Start { static constexpr event_id_t id = 1; };
+/// struct Stop { static constexpr event_id_t id = 2; };
+/// struct Motor : StaticHsm<Motor> {
+///     using initial_state = Idle;
+///     using transitions = TransitionTable<
+///       Row<Idle, Start, Running, SpinUp, HasPower>,
+///       Row<Running, Stop, Idle>>;
+/// };
+///
+/// Actions and guards are default constructible function objects called with
+/// the machine (as the derived type) and the Event being handled:
+/// struct SpinUp { void operator()(Motor& m, Event const& e) const; };
+/// struct HasPower { bool operator()(Motor& m, Event const& e) const; };
+///
+/// Rows with the same source state and event are tried in order until a
+/// guard passes.
+///
+/// A machine may also name a stop state, which exits it once entered, as
+/// setStopState does for Hsm:
+/// using stop_state = Off;
+///
+template<typename From,
+         typename Ev,
+         typename To,
+         typename Action = NoAction,
+         typename Guard = NoGuard>
+struct Row
+{
+    using from = From;
+    using event = Ev;
+    using to = To;
+    using action = Action;
+    using guard = Guard;
+};
+
+template<typename... Rows>
+struct TransitionTable
+{};
+
+// The Event to send for event type Ev
+template<typename Ev>
+Event
+eventOf(event_data_t data = 0)
+{
+    return Event(Ev::id, data);
+}
+
+namespace detail {
+
+template<typename... Ts>
+struct TypeList
+{
+    static constexpr std::size_t size = sizeof...(Ts);
+};
+
+template<typename T, typename List>
+struct IndexOf;
+
+template<typename T, typename... Ts>
+struct IndexOf<T, TypeList<T, Ts...>>
+  : std::integral_constant<std::size_t, 0>
+{};
+
+template<typename T, typename U, typename... Ts>
+struct IndexOf<T, TypeList<U, Ts...>>
+  : std::integral_constant<std::size_t,
+                           1 + IndexOf<T, TypeList<Ts...>>::value>
+{};
+
+template<typename T, typename List>
+struct Contains;
+
+template<typename T>
+struct Contains<T, TypeList<>> : std::false_type
+{};
+
+template<typename T, typename U, typename... Ts>
+struct Contains<T, TypeList<U, Ts...>>
+  : std::conditional_t<std::is_same<T, U>::value,
+                       std::true_type,
+                       Contains<T, TypeList<Ts...>>>
+{};
+
+template<typename List, typename T, bool = Contains<T, List>::value>
+struct AddUnique
+{
+    using type = List;
+};
+
+template<typename... Ts, typename T>
+struct AddUnique<TypeList<Ts...>, T, false>
+{
+    using type = TypeList<Ts..., T>;
+};
+
+// The distinct source/target states, in order of first appearance
+template<typename List, typename... Rows>
+struct CollectStates
+{
+    using type = List;
+};
+
+template<typename List, typename R, typename... Rows>
+struct CollectStates<List, R, Rows...>
+{
+    using type = typename CollectStates<
+      typename AddUnique<typename AddUnique<List, typename R::from>::type,
+                         typename R::to>::type,
+      Rows...>::type;
+};
+
+// The distinct events, in order of first appearance
+template<typename List, typename... Rows>
+struct CollectEvents
+{
+    using type = List;
+};
+
+template<typename List, typename R, typename... Rows>
+struct CollectEvents<List, R, Rows...>
+{
+    using type =
+      typename CollectEvents<typename AddUnique<List, typename R::event>::type,
+                             Rows...>::type;
+};
+
+// The index of T in List, List::size if it is not there
+template<typename T, typename List, bool = Contains<T, List>::value>
+struct FindIndex : std::integral_constant<std::size_t, List::size>
+{};
+
+template<typename T, typename List>
+struct FindIndex<T, List, true> : IndexOf<T, List>
+{};
+
+// Def::stop_state, void if Def has none
+template<typename Def, typename = void>
+struct StopStateOf
+{
+    using type = void;
+};
+
+template<typename Def>
+struct StopStateOf<Def, std::conditional_t<true, void, typename Def::stop_state>>
+{
+    using type = typename Def::stop_state;
+};
+
+template<std::size_t I, typename List>
+struct At;
+
+template<typename T, typename... Ts>
+struct At<0, TypeList<T, Ts...>>
+{
+    using type = T;
+};
+
+template<std::size_t I, typename T, typename... Ts>
+struct At<I, TypeList<T, Ts...>>
+{
+    using type = typename At<I - 1, TypeList<Ts...>>::type;
+};
+
+constexpr uint16_t NO_ROW = 0xFFFF;
+
+///
+/// For every (state, event) cell the first row that handles it, and for every
+/// row the next row with the same state and event (the guard alternatives).
+///
+template<std::size_t NStates, std::size_t NEvents, std::size_t NRows>
+struct RowIndex
+{
+    uint16_t cells[NStates][NEvents];
+    uint16_t alternative[NRows];
+};
+
+template<std::size_t NStates, std::size_t NEvents, std::size_t NRows>
+constexpr RowIndex<NStates, NEvents, NRows>
+makeRowIndex(std::size_t const (&from)[NRows],
+             std::size_t const (&event)[NRows])
+{
+    RowIndex<NStates, NEvents, NRows> index{};
+    for (std::size_t s = 0; s < NStates; ++s) {
+        for (std::size_t e = 0; e < NEvents; ++e) {
+            index.cells[s][e] = NO_ROW;
+        }
+    }
+    for (std::size_t r = NRows; r-- > 0;) {
+        index.alternative[r] = index.cells[from[r]][event[r]];
+        index.cells[from[r]][event[r]] = static_cast<uint16_t>(r);
+    }
+    return index;
+}
+
+template<typename Def, typename Table>
+struct StaticTraits;
+
+template<typename Def, typename... Rows>
+struct StaticTraits<Def, TransitionTable<Rows...>>
+{
+    static_assert(sizeof...(Rows) > 0, "Empty transition table");
+
+    using States =
+      typename CollectStates<TypeList<>, Rows...>::type;
+    using Events =
+      typename CollectEvents<TypeList<>, Rows...>::type;
+    static constexpr std::size_t NSTATES = States::size;
+    static constexpr std::size_t NEVENTS = Events::size;
+    static constexpr std::size_t NROWS = sizeof...(Rows);
+    static constexpr std::size_t INITIAL =
+      IndexOf<typename Def::initial_state, States>::value;
+    // NSTATES if there is no stop state
+    static constexpr std::size_t STOP =
+      FindIndex<typename StopStateOf<Def>::type, States>::value;
+    static_assert(std::is_void<typename StopStateOf<Def>::type>::value ||
+                    STOP < NSTATES,
+                  "The stop_state is not in the transitions");
+
+    using Handler = bool (*)(Def&, Event const&);
+
+    // The handler for one row, with its guard and action inlined
+    template<typename R>
+    static bool fire(Def& fsm, Event const& e)
+    {
+        typename R::guard guard;
+        if (!guard(fsm, e)) {
+            return false;
+        }
+        typename R::action action;
+        action(fsm, e);
+        constexpr std::size_t to = IndexOf<typename R::to, States>::value;
+        fsm.enter(to);
+        if (to == STOP) {
+            fsm.onExit(tsm::null_event);
+        }
+        return true;
+    }
+
+    static constexpr Handler handlers[NROWS] = { &fire<Rows>... };
+
+    static RowIndex<NSTATES, NEVENTS, NROWS> const& rowIndex()
+    {
+        static constexpr std::size_t from[NROWS] = {
+            IndexOf<typename Rows::from, States>::value...
+        };
+        static constexpr std::size_t event[NROWS] = {
+            IndexOf<typename Rows::event, Events>::value...
+        };
+        static constexpr RowIndex<NSTATES, NEVENTS, NROWS> index =
+          makeRowIndex<NSTATES, NEVENTS>(from, event);
+        return index;
+    }
+
+    // A chain of comparisons against the event ids, which the compiler turns
+    // into a switch. Returns NEVENTS for unknown ids.
+    template<std::size_t I>
+    static std::size_t eventIndex(event_id_t id, std::true_type /*more*/)
+    {
+        if (id == At<I, Events>::type::id) {
+            return I;
+        }
+        return eventIndex<I + 1>(
+          id, std::integral_constant<bool, (I + 1 < NEVENTS)>{});
+    }
+
+    template<std::size_t I>
+    static std::size_t eventIndex(event_id_t, std::false_type /*more*/)
+    {
+        return NEVENTS;
+    }
+
+    static std::size_t eventIndex(event_id_t id)
+    {
+        return eventIndex<0>(id, std::true_type{});
+    }
+};
+
+template<typename Def, typename... Rows>
+constexpr typename StaticTraits<Def, TransitionTable<Rows...>>::Handler
+  StaticTraits<Def, TransitionTable<Rows...>>::handlers[];
+
+} // namespace detail
+
+///
+/// An Hsm whose transition table is the type Def::transitions. handle maps the
+/// event id to an event index with a chain of constant comparisons, reads the
+/// row from a constexpr [state][event] array and calls that row's handler
+/// through a table of function pointers. Each handler is instantiated for its
+/// Row, so the guard and the action are inlined into it. There is no hashing
+/// and nothing is registered at runtime.
+///
+/// It derives from IHsm, so the execution policies and OrthogonalHsm work with
+/// it as with Hsm. getCurrentState returns the State object standing in for
+/// the current state type, see state<S>(). Entry and exit behaviour belongs in
+/// the Row actions; the stand-in State objects are never notified, not even
+/// when the machine itself is entered or exited.
+///
+template<typename Def>
+struct StaticHsm : public IHsm
+{
+    explicit StaticHsm(IHsm* parent = nullptr)
+      : IHsm(parent)
+      , states_(new State[Traits<Def>::NSTATES])
+    {
+        if (Traits<Def>::STOP < Traits<Def>::NSTATES) {
+            this->setStopState(&states_[Traits<Def>::STOP]);
+        }
+    }
+
+    // As IHsm's, without notifying the stand-in States
+    void onEntry(Event const& /*e*/) override
+    {
+        enter(Traits<Def>::INITIAL);
+        if (this->getParent() != nullptr) {
+            this->getParent()->onChildEntry(*this);
+        }
+    }
+
+    void onExit(Event const& /*e*/) override
+    {
+        this->setCurrentState(nullptr);
+        if (this->getParent() != nullptr) {
+            this->getParent()->onChildExit(*this);
+        }
+    }
+
+    State* getStartState() override
+    {
+        return &states_[Traits<Def>::INITIAL];
+    }
+
+    void handle(Event const& nextEvent) override
+    {
+        using T = Traits<Def>;
+        const std::size_t e = T::eventIndex(nextEvent.id);
+        if (e < T::NEVENTS) {
+            uint16_t row = T::rowIndex().cells[current_][e];
+            while (row != detail::NO_ROW) {
+                if (T::handlers[row](static_cast<Def&>(*this), nextEvent)) {
+                    return;
+                }
+                row = T::rowIndex().alternative[row];
+            }
+        }
+        if (this->getParent() != nullptr) {
+            this->getParent()->handle(nextEvent);
+        } else {
+            LOG(ERROR) << "Reached top level Hsm. Cannot handle event";
+        }
+    }
+
+    // The State object standing in for state type S
+    template<typename S>
+    State& state()
+    {
+        return states_[detail::IndexOf<S, typename Traits<Def>::States>::value];
+    }
+
+    template<typename S>
+    bool is() const
+    {
+        return current_ ==
+               detail::IndexOf<S, typename Traits<Def>::States>::value;
+    }
+
+    std::set<Event> const& getEvents() const
+    {
+        static const std::set<Event> events = eventSet(
+          static_cast<typename Def::transitions*>(nullptr));
+        return events;
+    }
+
+  private:
+    // Def is incomplete while StaticHsm<Def> is instantiated as its base, so
+    // the traits are only looked up inside member functions.
+    template<typename D>
+    using Traits = detail::StaticTraits<D, typename D::transitions>;
+
+    template<typename, typename>
+    friend struct detail::StaticTraits;
+
+    template<typename... Rows>
+    static std::set<Event> eventSet(TransitionTable<Rows...>*)
+    {
+        return std::set<Event>{ Event(Rows::event::id)... };
+    }
+
+    void enter(std::size_t s)
+    {
+        current_ = s;
+        this->setCurrentState(&states_[s]);
+    }
+
+    std::size_t current_{};
+    std::unique_ptr<State[]> states_;
+};
+
+} // namespace tsm
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tsm {
+
+///
+/// A unit of work for an executor. PooledExecutionPolicy state machines are
+/// Runnables: run processes some of the events in their mailbox.
+///
+struct Runnable
+{
+    static constexpr std::size_t NO_AFFINITY = ~std::size_t(0);
+
+    virtual ~Runnable() = default;
+    virtual void run() = 0;
+
+    // The worker that last ran this Runnable. Executors that keep work on the
+    // same worker for cache warmth (WorkStealingExecutor) use it as a hint.
+    std::size_t getAffinity() const
+    {
+        return affinity_.load(std::memory_order_relaxed);
+    }
+    void setAffinity(std::size_t worker)
+    {
+        affinity_.store(worker, std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<std::size_t> affinity_{ NO_AFFINITY };
+};
+
+///
+/// A fixed pool of worker threads sharing a single FIFO run queue. Any thread
+/// may schedule a Runnable; the next free worker runs it. Nothing is ever run
+/// twice for one schedule call, so a Runnable that schedules itself at most
+/// once at a time is never run by two workers at once.
+///
+/// On destruction the pool runs everything still queued (including work
+/// scheduled while draining) and then joins its workers. It must outlive
+/// every Runnable that schedules itself on it.
+///
+struct ThreadPoolExecutor
+{
+    explicit ThreadPoolExecutor(std::size_t nWorkers = defaultWorkers())
+    {
+        if (nWorkers == 0) {
+            nWorkers = 1;
+        }
+        workers_.reserve(nWorkers);
+        for (std::size_t i = 0; i < nWorkers; ++i) {
+            workers_.emplace_back(&ThreadPoolExecutor::work, this, i);
+        }
+    }
+
+    ThreadPoolExecutor(ThreadPoolExecutor const&) = delete;
+    ThreadPoolExecutor(ThreadPoolExecutor&&) = delete;
+    ThreadPoolExecutor operator=(ThreadPoolExecutor const&) = delete;
+    ThreadPoolExecutor operator=(ThreadPoolExecutor&&) = delete;
+
+    ~ThreadPoolExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cvWork_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    void schedule(Runnable* r)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ready_.push_back(r);
+        }
+        cvWork_.notify_one();
+    }
+
+    std::size_t size() const { return workers_.size(); }
+
+    static std::size_t defaultWorkers()
+    {
+        const std::size_t n = std::thread::hardware_concurrency();
+        return n == 0 ? 1 : n;
+    }
+
+  private:
+    void work(std::size_t w)
+    {
+        for (;;) {
+            Runnable* r;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cvWork_.wait(
+                  lock, [this] { return !this->ready_.empty() || this->stop_; });
+                if (ready_.empty()) {
+                    return;
+                }
+                r = ready_.front();
+                ready_.pop_front();
+            }
+            r->setAffinity(w);
+            r->run();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cvWork_;
+    std::deque<Runnable*> ready_;
+    bool stop_{};
+    std::vector<std::thread> workers_;
+};
+
+} // namespace tsm
@@ -60,6 +60,10 @@ struct ThreadSleepTimer
 /// type. A callback from this policy is invoked from the Timer every time a
 /// preset time period expires.
 ///
+/// On top of an AsyncExecutionPolicy, mark timer_event coalescable
+/// (getEventQueue().setCoalescable(timer_event)) so that ticks do not pile up
+/// while the machine is busy.
+///
 template<typename StateType,
          template<typename>
          class TimerType,
@@ -1,25 +1,49 @@
 #pragma once
+#include "Arena.h"
 #include "Event.h"
+#include "InlineFunction.h"
 #include "State.h"
+#include "UniqueId.h"
 
-#include <set>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <set>
+#include <stdexcept>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 namespace tsm {
     
-using ActionFn = std::function<void (Event const& e)>;
-using GuardFn = std::function<bool (Event const& e)>;
+// Stored inline in each Transition, or in the side tables of
+// PackedTransitions; see InlineFunction
+using ActionFn = InlineFunction<void(Event const& e)>;
+using GuardFn = InlineFunction<bool(Event const& e)>;
 
-template<typename FsmDef>
-struct StateTransitionTableT
+///
+/// The default transition table. Allocator (any allocator, it is rebound for
+/// each container) is where the table's hash nodes, event set and frozen
+/// index live, e.g. ArenaAllocator<char> to build a machine out of an Arena;
+/// StateTransitionTableT and ArenaStateTransitionTableT name the common
+/// choices. A default constructed table uses a default constructed
+/// Allocator; pass one to the constructor, or to Hsm's, to choose it.
+///
+template<typename FsmDef, typename Allocator>
+struct BasicStateTransitionTableT
 {
+    template<typename T>
+    using Alloc =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+    using EventSet = std::set<Event, std::less<Event>, Alloc<Event>>;
+    using allocator_type = Allocator;
 
     struct Transition
     {
         Transition(State& toState, ActionFn action, GuardFn guard)
           : toState(toState)
-          , action(action)
-          , guard(guard)
+          , action(std::move(action))
+          , guard(std::move(guard))
         {}
 
         bool doTransition(FsmDef* hsm, Event const& e)
@@ -50,25 +74,73 @@ struct StateTransitionTableT
     };
 
     using StateEventPair = std::pair<State&, Event>;
+
+    // State and event ids packed side by side, so distinct pairs never share
+    // a key.
+    static uint64_t key(State const& s, Event const& e)
+    {
+        return (static_cast<uint64_t>(s.id) << 32) | e.id;
+    }
+
+    // Fibonacci hashing: the high bits of the product are well mixed
+    static uint64_t mix(uint64_t key, uint64_t seed = 0)
+    {
+        return (key ^ seed) * 0x9E3779B97F4A7C15ULL;
+    }
+
     struct HashStateEventPair
     {
         size_t operator()(const StateEventPair& s) const
         {
-            auto a = s.first.id;
-            auto b = s.second.id;
-            return (a + b) * (a + b + 1) / 2 + a;
+            return static_cast<size_t>(mix(key(s.first, s.second)) >> 32);
         }
     };
 
     using TransitionTableElement = std::pair<StateEventPair, Transition>;
-    using TransitionTable =
-      std::unordered_map<typename TransitionTableElement::first_type,
-                         typename TransitionTableElement::second_type,
-                         HashStateEventPair>;
+    using TransitionTable = std::unordered_map<
+      typename TransitionTableElement::first_type,
+      typename TransitionTableElement::second_type,
+      HashStateEventPair,
+      std::equal_to<StateEventPair>,
+      Alloc<std::pair<StateEventPair const, Transition>>>;
 
   public:
+    BasicStateTransitionTableT() = default;
+
+    explicit BasicStateTransitionTableT(Allocator const& allocator)
+      : data_(Alloc<std::pair<StateEventPair const, Transition>>(allocator))
+      , eventSet_(Alloc<Event>(allocator))
+      , states_(Alloc<std::pair<uint32_t const, std::size_t>>(allocator))
+      , events_(Alloc<std::pair<uint32_t const, std::size_t>>(allocator))
+      , slots_(Alloc<Slot>(allocator))
+    {}
+
+    // Hsm takes transitions through its table, see PackedTransitions
+    bool doTransition(Transition* t, FsmDef* hsm, Event const& e)
+    {
+        return t->doTransition(hsm, e);
+    }
+
+    State& target(Transition const& t) const { return t.toState; }
+
     Transition* next(State& fromState, Event const& onEvent)
     {
+        if (frozen_) {
+            const uint64_t k = key(fromState, onEvent);
+            std::size_t slot = mix(k, seed_) >> shift_;
+            for (std::size_t probe = 0; probe <= maxProbe_; ++probe) {
+                Slot const& s = slots_[slot];
+                if (s.transition == nullptr) {
+                    return nullptr;
+                }
+                if (s.key == k) {
+                    return s.transition;
+                }
+                slot = (slot + 1) & (slots_.size() - 1);
+            }
+            return nullptr;
+        }
+
         // Check if event in Hsm
         StateEventPair pair(fromState, onEvent);
         auto it = data_.find(pair);
@@ -96,9 +168,84 @@ struct StateTransitionTableT
         Transition t(toState, action, guard);
         addTransition(fromState, onEvent, t);
         eventSet_.insert(onEvent);
+        states_.emplace(fromState.id, states_.size());
+        events_.emplace(onEvent.id, events_.size());
+        states_.emplace(toState.id, states_.size());
+        // Adding to a frozen table thaws it; freeze() again to rebuild.
+        frozen_ = false;
     }
 
-    std::set<Event> const& getEvents() const { return eventSet_; }
+    EventSet const& getEvents() const { return eventSet_; }
+
+    // Dense indices 0, 1, 2... in the order add() first sees the states
+    // (source, then target) and events, so they are the same for every
+    // instance of a machine type. DenseIndex::NONE if not in the table.
+    std::size_t stateIndex(State const& s) const
+    {
+        return indexOf(states_, s.id);
+    }
+    std::size_t eventIndex(Event const& e) const
+    {
+        return indexOf(events_, e.id);
+    }
+    std::size_t stateCount() const { return states_.size(); }
+    std::size_t eventCount() const { return events_.size(); }
+
+    ///
+    /// Builds a read-only open-addressing index over the transitions for
+    /// next() to use instead of the unordered_map. The index has a power of
+    /// two number of slots, at least twice the number of transitions, and a
+    /// few hash seeds are tried to find one that places every transition in
+    /// its home slot, i.e. a perfect hash. If none does, the seed with the
+    /// shortest longest probe is kept and lookups probe linearly, never
+    /// further than that. A lookup on a frozen table is a multiply, a shift
+    /// and usually one slot compare; it never allocates.
+    ///
+    /// Hsm freezes its table when the machine is started.
+    ///
+    void freeze()
+    {
+        if (frozen_) {
+            return;
+        }
+        std::size_t bits = 1;
+        while ((std::size_t(1) << bits) < 2 * data_.size()) {
+            ++bits;
+        }
+        Slots best(slots_.get_allocator());
+        uint64_t bestSeed = 0;
+        std::size_t bestProbe = SIZE_MAX;
+        uint64_t seed = 0;
+        for (int attempt = 0; attempt < FREEZE_ATTEMPTS && bestProbe > 0;
+             ++attempt, seed += 0x632BE59BD9B4E019ULL) {
+            Slots slots(
+              std::size_t(1) << bits, Slot{}, slots_.get_allocator());
+            std::size_t longest = 0;
+            for (auto& it : data_) {
+                const uint64_t k = key(it.first.first, it.first.second);
+                std::size_t slot = mix(k, seed) >> (64 - bits);
+                std::size_t probe = 0;
+                while (slots[slot].transition != nullptr) {
+                    slot = (slot + 1) & (slots.size() - 1);
+                    ++probe;
+                }
+                slots[slot] = Slot{ k, &it.second };
+                longest = probe > longest ? probe : longest;
+            }
+            if (longest < bestProbe) {
+                best.swap(slots);
+                bestSeed = seed;
+                bestProbe = longest;
+            }
+        }
+        slots_.swap(best);
+        seed_ = bestSeed;
+        shift_ = 64 - bits;
+        maxProbe_ = bestProbe;
+        frozen_ = true;
+    }
+
+    bool isFrozen() const { return frozen_; }
 
   private:
     void addTransition(State& fromState,
@@ -109,8 +256,183 @@ struct StateTransitionTableT
         TransitionTableElement e(pair, t);
         data_.insert(e);
     }
+
+    // Ids here may be anything, too sparse for a DenseIndex
+    using IdIndex =
+      std::unordered_map<uint32_t,
+                         std::size_t,
+                         std::hash<uint32_t>,
+                         std::equal_to<uint32_t>,
+                         Alloc<std::pair<uint32_t const, std::size_t>>>;
+
+    static std::size_t indexOf(IdIndex const& index, uint32_t id)
+    {
+        auto it = index.find(id);
+        return it == index.end() ? DenseIndex::NONE : it->second;
+    }
+
+    static constexpr int FREEZE_ATTEMPTS = 16;
+
+    struct Slot
+    {
+        uint64_t key;
+        // Points into data_, whose nodes stay put. nullptr for an empty slot.
+        Transition* transition;
+    };
+    using Slots = std::vector<Slot, Alloc<Slot>>;
+
     TransitionTable data_;
-    std::set<Event> eventSet_;
+    EventSet eventSet_;
+    IdIndex states_;
+    IdIndex events_;
+
+    bool frozen_{};
+    Slots slots_;
+    uint64_t seed_{};
+    std::size_t shift_{};
+    std::size_t maxProbe_{};
 };
 
+///
+/// A transition packed into 8 bytes, for tables that give states dense
+/// indices: the target's index and the positions of the action and guard in
+/// side tables, instead of a State& and two inline functions (112 bytes). The
+/// records of a small machine fit in a cache line or two. Only the dense and
+/// enum tables (and MachineDefinition) use it; BasicStateTransitionTableT
+/// keeps its Transition and has no internal transitions.
+///
+struct PackedTransition
+{
+    // An internal transition runs its action without leaving the state, so
+    // there are no exit or entry calls.
+    static constexpr uint16_t INTERNAL = 1;
+
+    // Dense index of the target state
+    uint16_t toState;
+    // 1 + index into the side table, 0 for none
+    uint16_t action;
+    uint16_t guard;
+    uint16_t flags;
+};
+
+static_assert(sizeof(PackedTransition) == 8, "PackedTransition is 8 bytes");
+
+///
+/// The PackedTransition records of a table and their side tables: the target
+/// State of each dense state index and the actions and guards. Only
+/// transitions that have an action or a guard add one. Positions and state
+/// indices are 16 bits, so a table holds at most MAX_TRANSITIONS transitions
+/// between MAX_STATES states; add throws std::length_error past that.
+///
+template<typename FsmDef, typename Allocator>
+struct PackedTransitions
+{
+    template<typename T>
+    using Alloc =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+
+    static constexpr std::size_t MAX_STATES = std::size_t(UINT16_MAX) + 1;
+    // Cells hold 1 + a position, 0 being no transition
+    static constexpr std::size_t MAX_TRANSITIONS = UINT16_MAX;
+
+    PackedTransitions() = default;
+
+    explicit PackedTransitions(Allocator const& allocator)
+      : records_(Alloc<PackedTransition>(allocator))
+      , states_(Alloc<State*>(allocator))
+      , actions_(Alloc<ActionFn>(allocator))
+      , guards_(Alloc<GuardFn>(allocator))
+    {}
+
+    // Appends a transition to toState, whose dense index is toIndex.
+    // Returns 1 + its position.
+    uint16_t add(std::size_t toIndex,
+                 State& toState,
+                 ActionFn action,
+                 GuardFn guard,
+                 uint16_t flags)
+    {
+        if (toIndex >= MAX_STATES) {
+            throw std::length_error("Too many states for PackedTransitions");
+        }
+        // Actions and guards are never more than the transitions
+        if (records_.size() >= MAX_TRANSITIONS) {
+            throw std::length_error(
+              "Too many transitions for PackedTransitions");
+        }
+        if (toIndex >= states_.size()) {
+            states_.resize(toIndex + 1, nullptr);
+        }
+        states_[toIndex] = &toState;
+        PackedTransition t{ static_cast<uint16_t>(toIndex), 0, 0, flags };
+        if (action) {
+            actions_.push_back(std::move(action));
+            t.action = static_cast<uint16_t>(actions_.size());
+        }
+        if (guard) {
+            guards_.push_back(std::move(guard));
+            t.guard = static_cast<uint16_t>(guards_.size());
+        }
+        records_.push_back(t);
+        return static_cast<uint16_t>(records_.size());
+    }
+
+    PackedTransition* at(uint16_t cell) { return &records_[cell - 1]; }
+
+    State& target(PackedTransition const& t) const
+    {
+        return *states_[t.toState];
+    }
+
+    // As StateTransitionTableT's Transition::doTransition
+    bool doTransition(PackedTransition const& t,
+                      FsmDef* hsm,
+                      Event const& e) const
+    {
+        if (t.guard != 0 && !guards_[t.guard - 1](e)) {
+            return false;
+        }
+        if ((t.flags & PackedTransition::INTERNAL) != 0) {
+            if (t.action != 0) {
+                actions_[t.action - 1](e);
+            }
+            return true;
+        }
+        hsm->getCurrentState()->onExit(e);
+        if (t.action != 0) {
+            actions_[t.action - 1](e);
+        }
+        State& to = target(t);
+        hsm->setCurrentState(&to);
+        to.onEntry(e);
+        return true;
+    }
+
+    std::size_t size() const { return records_.size(); }
+    std::size_t recordBytes() const
+    {
+        return records_.size() * sizeof(PackedTransition);
+    }
+
+  private:
+    std::vector<PackedTransition, Alloc<PackedTransition>> records_;
+    std::vector<State*, Alloc<State*>> states_;
+    std::vector<ActionFn, Alloc<ActionFn>> actions_;
+    std::vector<GuardFn, Alloc<GuardFn>> guards_;
+};
+
+template<typename FsmDef, typename Allocator>
+constexpr std::size_t PackedTransitions<FsmDef, Allocator>::MAX_STATES;
+template<typename FsmDef, typename Allocator>
+constexpr std::size_t PackedTransitions<FsmDef, Allocator>::MAX_TRANSITIONS;
+
+template<typename FsmDef>
+using StateTransitionTableT =
+  BasicStateTransitionTableT<FsmDef, std::allocator<char>>;
+
+// Allocates out of the Arena of the ArenaScope the machine is built in
+template<typename FsmDef>
+using ArenaStateTransitionTableT =
+  BasicStateTransitionTableT<FsmDef, ArenaAllocator<char>>;
+
 } // namespace tsm
@@ -1,15 +1,153 @@
 #pragma once
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace tsm {
-using id_t = uint16_t;
+using id_t = uint32_t;
+
+///
+/// Hands out State ids. There is one counter for the whole process, so ids
+/// are unique across threads and machines, whichever thread constructs them.
+/// For array indexing use the dense per-machine indices instead, see
+/// Hsm::stateIndex.
+///
 struct Counter
 {
     static id_t counter_inc()
     {
-        thread_local id_t a = 0;
-        return ++a;
+        static std::atomic<id_t> a{ 0 };
+        return a.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+};
+
+///
+/// Maps sparse ids (state or event ids) to dense indices 0, 1, 2... in the
+/// order they are inserted. A lookup is a subtraction, a bounds check and one
+/// load from a flat array covering the span of inserted ids, so it is meant
+/// for ids that are reasonably close together, like the ones handed out by
+/// the id counters.
+///
+/// Ids come from process-wide counters, so a machine mixing long-lived
+/// states or events with ones created much later can have ids far apart.
+/// The array never spans more than MAX_SPAN_PER_ID slots per id (or
+/// MIN_SPAN); an id that would stretch it further goes into a hash map
+/// instead, which is only consulted for ids outside the array.
+///
+template<typename Allocator = std::allocator<uint32_t>>
+struct DenseIndexT
+{
+    static constexpr std::size_t NONE = ~std::size_t(0);
+    static constexpr std::size_t MIN_SPAN = 256;
+    static constexpr std::size_t MAX_SPAN_PER_ID = 8;
+
+    DenseIndexT() = default;
+    explicit DenseIndexT(Allocator const& allocator)
+      : slots_(allocator)
+      , outliers_(OutlierAlloc(allocator))
+    {}
+
+    // The index of id, or NONE
+    std::size_t find(uint32_t id) const
+    {
+        // Ids below base_ wrap around to a large offset
+        const uint32_t offset = id - base_;
+        if (offset < slots_.size()) {
+            return static_cast<std::size_t>(slots_[offset]) - 1;
+        }
+        if (outliers_.empty()) {
+            return NONE;
+        }
+        auto it = outliers_.find(id);
+        return it == outliers_.end() ? NONE : it->second;
+    }
+
+    // The index of id, assigning the next free one if id is new
+    std::size_t insert(uint32_t id)
+    {
+        std::size_t index = find(id);
+        if (index != NONE) {
+            return index;
+        }
+        if (slots_.empty()) {
+            base_ = id;
+        }
+        // The span of the array with id in it
+        const uint64_t low = id < base_ ? id : base_;
+        const uint64_t high = id < base_ + slots_.size()
+                                ? uint64_t(base_) + slots_.size() - 1
+                                : id;
+        std::size_t limit = (size_ + 1) * MAX_SPAN_PER_ID;
+        if (limit < MIN_SPAN) {
+            limit = MIN_SPAN;
+        }
+        if (high - low + 1 > limit) {
+            outliers_.emplace(id, size_);
+            return size_++;
+        }
+        if (id < base_) {
+            slots_.insert(slots_.begin(), base_ - id, 0);
+            base_ = id;
+        }
+        const uint32_t offset = id - base_;
+        if (offset >= slots_.size()) {
+            slots_.resize(offset + 1, 0);
+        }
+        slots_[offset] = static_cast<uint32_t>(++size_);
+        return size_ - 1;
     }
+
+    std::size_t size() const { return size_; }
+
+    // Slots in the flat array, and ids kept in the hash map instead
+    std::size_t span() const { return slots_.size(); }
+    std::size_t outliers() const { return outliers_.size(); }
+
+  private:
+    using OutlierAlloc = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<std::pair<uint32_t const, std::size_t>>;
+
+    uint32_t base_{};
+    std::size_t size_{};
+    // index + 1 for every id in [base_, base_ + slots_.size()), 0 if unused
+    std::vector<uint32_t, Allocator> slots_;
+    // Ids that would have made slots_ too long
+    std::unordered_map<uint32_t,
+                       std::size_t,
+                       std::hash<uint32_t>,
+                       std::equal_to<uint32_t>,
+                       OutlierAlloc>
+      outliers_;
 };
 
+template<typename Allocator>
+constexpr std::size_t DenseIndexT<Allocator>::NONE;
+template<typename Allocator>
+constexpr std::size_t DenseIndexT<Allocator>::MIN_SPAN;
+template<typename Allocator>
+constexpr std::size_t DenseIndexT<Allocator>::MAX_SPAN_PER_ID;
+
+using DenseIndex = DenseIndexT<>;
+
+// The index of the lowest set bit of a non-zero mask
+inline std::size_t
+lowestSetBit(uint32_t mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<std::size_t>(__builtin_ctz(mask));
+#else
+    std::size_t bit = 0;
+    while ((mask & 1U) == 0) {
+        mask >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
 } // namespace tsm
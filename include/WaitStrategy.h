@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+namespace tsm {
+
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+// Tell the CPU we are in a spin loop
+inline void
+cpuRelax()
+{
+#if (defined(__GNUC__) || defined(__clang__)) &&                               \
+  (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+///
+/// Wait strategies decide what a consumer does before it parks on the event
+/// queue's condition variable. spin(ready) polls the lock free probe ready and
+/// returns true as soon as it reports work, or false once the budget is spent
+/// and the consumer should park.
+///
+/// BlockingWait parks straight away. This is the cheapest option for machines
+/// that are idle most of the time.
+///
+struct BlockingWait
+{
+    template<typename Probe>
+    static bool spin(Probe&&)
+    {
+        return false;
+    }
+};
+
+///
+/// Busy-spin for SpinCount polls, then yield the CPU for YieldCount polls,
+/// then park. A machine that receives an event every few microseconds then
+/// picks it up without a futex sleep/wake round trip, at the cost of burning
+/// a core while it waits. Only worth it when the consumer has a core to
+/// itself.
+///
+template<std::size_t SpinCount = 2000, std::size_t YieldCount = 50>
+struct SpinThenParkWait
+{
+    template<typename Probe>
+    static bool spin(Probe&& ready)
+    {
+        for (std::size_t i = 0; i < SpinCount; ++i) {
+            if (ready()) {
+                return true;
+            }
+            cpuRelax();
+        }
+        for (std::size_t i = 0; i < YieldCount; ++i) {
+            if (ready()) {
+                return true;
+            }
+            std::this_thread::yield();
+        }
+        return false;
+    }
+};
+
+} // namespace tsm
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "ThreadPoolExecutor.h"
+#include "WaitStrategy.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tsm {
+
+///
+/// A drop-in replacement for ThreadPoolExecutor that gives every worker a run
+/// queue of its own instead of sharing one, so scheduling does not serialize
+/// on a single lock at high core counts.
+///
+/// A Runnable is queued on the worker that last ran it (its affinity), which
+/// keeps a state machine and its data warm in that worker's cache. Runnables
+/// scheduled from a worker thread without an affinity stay on that worker;
+/// others are spread round robin. A worker takes from the front of its own
+/// queue and, when that is empty, steals from the back of the others' queues.
+/// A stolen Runnable moves to the thief for good.
+///
+/// As with ThreadPoolExecutor, a Runnable is run once per schedule call, so a
+/// PooledExecutionPolicy machine is never run by two workers at once.
+///
+struct WorkStealingExecutor
+{
+    explicit WorkStealingExecutor(
+      std::size_t nWorkers = ThreadPoolExecutor::defaultWorkers())
+      : nWorkers_(nWorkers == 0 ? 1 : nWorkers)
+      , queues_(new RunQueue[nWorkers_])
+    {
+        workers_.reserve(nWorkers_);
+        for (std::size_t i = 0; i < nWorkers_; ++i) {
+            workers_.emplace_back(&WorkStealingExecutor::work, this, i);
+        }
+    }
+
+    WorkStealingExecutor(WorkStealingExecutor const&) = delete;
+    WorkStealingExecutor(WorkStealingExecutor&&) = delete;
+    WorkStealingExecutor operator=(WorkStealingExecutor const&) = delete;
+    WorkStealingExecutor operator=(WorkStealingExecutor&&) = delete;
+
+    // Runs everything still queued, then joins the workers.
+    ~WorkStealingExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(parkMutex_);
+            stop_ = true;
+        }
+        cvWork_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    void schedule(Runnable* r)
+    {
+        std::size_t w = r->getAffinity();
+        if (w >= nWorkers_) {
+            w = (current().executor == this)
+                  ? current().index
+                  : next_.fetch_add(1, std::memory_order_relaxed) % nWorkers_;
+        }
+        // Count it first so the count never goes negative. Pairs with the
+        // idle_/pending_ check in park.
+        pending_.fetch_add(1, std::memory_order_seq_cst);
+        {
+            std::lock_guard<std::mutex> lock(queues_[w].mutex);
+            queues_[w].runnables.push_back(r);
+        }
+        if (idle_.load(std::memory_order_seq_cst) != 0) {
+            std::lock_guard<std::mutex> lock(parkMutex_);
+            cvWork_.notify_one();
+        }
+    }
+
+    std::size_t size() const { return nWorkers_; }
+
+  private:
+    struct RunQueue
+    {
+        std::mutex mutex;
+        std::deque<Runnable*> runnables;
+        // Keep neighbouring queues off each other's cache lines
+        char padding[CACHE_LINE_SIZE];
+    };
+
+    struct WorkerSlot
+    {
+        WorkStealingExecutor* executor;
+        std::size_t index;
+    };
+
+    static WorkerSlot& current()
+    {
+        static thread_local WorkerSlot slot{ nullptr, 0 };
+        return slot;
+    }
+
+    Runnable* pop(std::size_t w)
+    {
+        RunQueue& q = queues_[w];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.runnables.empty()) {
+            return nullptr;
+        }
+        Runnable* r = q.runnables.front();
+        q.runnables.pop_front();
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        return r;
+    }
+
+    Runnable* steal(std::size_t thief)
+    {
+        for (std::size_t i = 1; i < nWorkers_; ++i) {
+            RunQueue& q = queues_[(thief + i) % nWorkers_];
+            std::unique_lock<std::mutex> lock(q.mutex, std::try_to_lock);
+            if (!lock.owns_lock() || q.runnables.empty()) {
+                continue;
+            }
+            Runnable* r = q.runnables.back();
+            q.runnables.pop_back();
+            pending_.fetch_sub(1, std::memory_order_relaxed);
+            return r;
+        }
+        return nullptr;
+    }
+
+    // Returns false once the executor is stopped and all work is done.
+    bool park()
+    {
+        std::unique_lock<std::mutex> lock(parkMutex_);
+        idle_.fetch_add(1, std::memory_order_seq_cst);
+        cvWork_.wait(lock, [this] {
+            return this->pending_.load(std::memory_order_seq_cst) != 0 ||
+                   this->stop_;
+        });
+        idle_.fetch_sub(1, std::memory_order_relaxed);
+        return pending_.load(std::memory_order_seq_cst) != 0;
+    }
+
+    void work(std::size_t w)
+    {
+        current() = WorkerSlot{ this, w };
+        for (;;) {
+            Runnable* r = pop(w);
+            if (r == nullptr) {
+                r = steal(w);
+            }
+            if (r != nullptr) {
+                r->setAffinity(w);
+                r->run();
+                continue;
+            }
+            // steal uses try_lock and schedule counts a Runnable before it is
+            // queued, so only park when nothing is pending at all
+            if (pending_.load(std::memory_order_seq_cst) != 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            if (!park()) {
+                return;
+            }
+        }
+    }
+
+    const std::size_t nWorkers_;
+    std::unique_ptr<RunQueue[]> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<std::size_t> next_{};
+    std::atomic<std::size_t> pending_{};
+    std::atomic<std::size_t> idle_{};
+
+    std::mutex parkMutex_;
+    std::condition_variable cvWork_;
+    bool stop_{};
+};
+
+} // namespace tsm
@@ -1,14 +1,28 @@
 #pragma once
 
+#include "Arena.h"
 #include "AsyncExecutionPolicy.h"
+#include "BoundedEventQueue.h"
+#include "CoroutineExecutionPolicy.h"
+#include "DenseTransitionTable.h"
+#include "EnumTransitionTable.h"
 #include "Event.h"
 #include "EventQueue.h"
+#include "Fleet.h"
 #include "Hsm.h"
+#include "InlineFunction.h"
+#include "LockFreeEventQueue.h"
+#include "MachineDefinition.h"
 #include "OrthogonalHsm.h"
+#include "PooledExecutionPolicy.h"
+#include "PriorityEventQueue.h"
 #include "SingleThreadedExecutionPolicy.h"
+#include "StaticHsm.h"
 #include "State.h"
+#include "ThreadPoolExecutor.h"
 #include "TimedExecutionPolicy.h"
 #include "Transition.h"
+#include "WorkStealingExecutor.h"
 
 namespace tsm {
 
@@ -46,6 +60,15 @@ using SingleThreadedHsm = SingleThreadedExecutionPolicy<Hsm>;
 template<typename Hsm>
 using AsynchronousHsm = AsyncExecutionPolicy<Hsm>;
 
+///
+/// A pooled state machine. Like AsynchronousHsm, but instead of a thread of its
+/// own it borrows a worker from a shared executor whenever it has events to
+/// process, so thousands of machines can share a handful of threads.
+/// ThreadPoolExecutor pool(4); PooledHsm<MyHsmDef> sm(pool);
+///
+template<typename Hsm>
+using PooledHsm = PooledExecutionPolicy<Hsm>;
+
 // The difference between Mealy and Moore machines is that Moore machines are
 // synchronously driven by a clock whereas Mealy machines are asynchronous. The
 // following are just aliases for SingleThreadedHsm and AsynchronousHsm.
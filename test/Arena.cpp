@@ -0,0 +1,220 @@
+#include "Arena.h"
+#include "DenseTransitionTable.h"
+#include "EnumTransitionTable.h"
+#include "Event.h"
+#include "Fleet.h"
+#include "Hsm.h"
+#include "State.h"
+#include "Transition.h"
+#include "tsm.h"
+
+#include <catch2/catch.hpp>
+
+#include <memory>
+#include <vector>
+
+using tsm::Arena;
+using tsm::ArenaAllocator;
+using tsm::ArenaScope;
+using tsm::Event;
+using tsm::Hsm;
+using tsm::SingleThreadedHsm;
+using tsm::State;
+
+namespace tsmtest {
+
+template<template<typename> class Table>
+struct ArenaGarageDoorHsm : public Hsm<ArenaGarageDoorHsm<Table>, Table>
+{
+    ArenaGarageDoorHsm()
+    {
+        this->setStartState(&DoorClosed);
+        this->add(DoorClosed, click_event, DoorOpening);
+        this->add(DoorOpening, sensor_hi_event, DoorOpen);
+        this->add(DoorOpen, click_event, DoorClosing);
+        this->add(DoorClosing, sensor_hi_event, DoorClosed);
+        this->add(DoorClosing, obstruct_event, DoorStoppedClosing);
+        this->add(DoorStoppedClosing, click_event, DoorOpening);
+    }
+
+    State DoorOpen, DoorOpening, DoorClosing, DoorClosed, DoorStoppedClosing;
+    Event click_event, sensor_hi_event, obstruct_event;
+};
+
+enum class LightState
+{
+    Off,
+    On,
+    Count
+};
+
+struct LightDef
+{
+    using Context = int;
+    using States = LightState;
+    static constexpr LightState initial = LightState::Off;
+
+    static void define(tsm::MachineDefinition<LightDef>& d)
+    {
+        d.add(LightState::Off, Event(1), LightState::On);
+        d.add(LightState::On, Event(1), LightState::Off);
+    }
+};
+
+constexpr LightState LightDef::initial;
+
+enum class DoorEvent
+{
+    Click,
+    Count
+};
+
+// Takes its arena explicitly rather than from a scope
+struct ExplicitArenaHsm
+  : public Hsm<ExplicitArenaHsm,
+               tsm::EnumTransitionTable<DoorEvent, ArenaAllocator<char>>::Table>
+{
+    explicit ExplicitArenaHsm(Arena& arena)
+      : Hsm(ArenaAllocator<char>(arena))
+    {
+        setStartState(&closed);
+        add(closed, DoorEvent::Click, open);
+        add(open, DoorEvent::Click, closed);
+    }
+
+    State closed, open;
+};
+
+template<template<typename> class Table>
+void
+runDoor(ArenaGarageDoorHsm<Table>& sm)
+{
+    sm.startSM();
+    sm.handle(sm.click_event);
+    sm.handle(sm.sensor_hi_event);
+    REQUIRE(sm.getCurrentState() == &sm.DoorOpen);
+    sm.handle(sm.click_event);
+    sm.handle(sm.obstruct_event);
+    REQUIRE(sm.getCurrentState() == &sm.DoorStoppedClosing);
+    sm.stopSM();
+}
+
+} // namespace tsmtest
+
+using tsmtest::ArenaGarageDoorHsm;
+using tsmtest::DoorEvent;
+using tsmtest::LightDef;
+using tsmtest::LightState;
+
+TEST_CASE("TestArena - testAllocator")
+{
+    Arena arena(256);
+    std::vector<int, ArenaAllocator<int>> outside;
+    {
+        ArenaScope scope(arena);
+        std::vector<int, ArenaAllocator<int>> inside;
+        inside.reserve(8);
+        CHECK(arena.allocated() == 8 * sizeof(int));
+        CHECK(inside.get_allocator().arena() == &arena);
+    }
+    // Outside any scope it is the heap
+    outside.push_back(1);
+    CHECK(outside.get_allocator().arena() == nullptr);
+    CHECK(arena.allocated() == 8 * sizeof(int));
+
+    // Allocations larger than a block get a block of their own
+    void* big = arena.allocate(1024, alignof(std::max_align_t));
+    CHECK(big != nullptr);
+    CHECK(arena.blockCount() == 2);
+    arena.release();
+    CHECK(arena.blockCount() == 0);
+    CHECK(arena.allocated() == 0);
+}
+
+TEST_CASE("TestArena - testMachinesInArena")
+{
+    Arena arena;
+    {
+        ArenaScope scope(arena);
+        ArenaGarageDoorHsm<tsm::ArenaStateTransitionTableT> hashed;
+        const std::size_t afterHashed = arena.allocated();
+        CHECK(afterHashed > 0);
+        ArenaGarageDoorHsm<tsm::ArenaDenseStateTransitionTableT> dense;
+        CHECK(arena.allocated() > afterHashed);
+
+        // Freezing on start allocates the index out of the arena too
+        const std::size_t beforeStart = arena.allocated();
+        tsmtest::runDoor(hashed);
+        CHECK(arena.allocated() > beforeStart);
+        tsmtest::runDoor(dense);
+    }
+
+    // The same machines built outside a scope leave the arena alone
+    const std::size_t before = arena.allocated();
+    ArenaGarageDoorHsm<tsm::ArenaStateTransitionTableT> heap;
+    tsmtest::runDoor(heap);
+    CHECK(arena.allocated() == before);
+}
+
+TEST_CASE("TestArena - testFleetInArena")
+{
+    Arena arena;
+    ArenaScope scope(arena);
+    tsm::Fleet<LightDef, ArenaAllocator<char>> fleet(1000);
+    CHECK(arena.allocated() >=
+          1000 * (sizeof(tsm::state_index_t) + sizeof(int)));
+
+    for (tsm::instance_id_t i = 0; i < fleet.size(); i += 2) {
+        fleet.dispatch(i, Event(1));
+    }
+    CHECK(fleet.count(LightState::On) == 500);
+}
+
+TEST_CASE("TestArena - testExplicitArena")
+{
+    Arena arena;
+    // No scope: the arena is passed in
+    tsmtest::ExplicitArenaHsm sm(arena);
+    CHECK(arena.allocated() > 0);
+    CHECK(sm.getTable().getEvents().get_allocator().arena() == &arena);
+    sm.startSM();
+    sm.handle(DoorEvent::Click);
+    CHECK(sm.getCurrentState() == &sm.open);
+
+    const std::size_t before = arena.allocated();
+    tsm::ArenaStateTransitionTableT<tsmtest::ExplicitArenaHsm> table(
+      ArenaAllocator<char>{ arena });
+    State a, b;
+    table.add(a, Event(1), b);
+    CHECK(arena.allocated() > before);
+
+    tsm::Fleet<LightDef, ArenaAllocator<char>> fleet(
+      10, ArenaAllocator<char>(arena));
+    CHECK(fleet.count(LightState::Off) == 10);
+}
+
+TEST_CASE("TestArena - testContainersAcrossArenas")
+{
+    Arena first, second;
+    using Vector = std::vector<int, ArenaAllocator<int>>;
+    Vector a({ 1, 2, 3 }, ArenaAllocator<int>(first));
+    Vector b({ 4, 5 }, ArenaAllocator<int>(second));
+    CHECK(a.get_allocator() != b.get_allocator());
+
+    // The allocator goes with the elements
+    std::swap(a, b);
+    CHECK(a.get_allocator().arena() == &second);
+    CHECK(b.get_allocator().arena() == &first);
+    CHECK(a == Vector({ 4, 5 }, ArenaAllocator<int>(second)));
+
+    Vector c{ ArenaAllocator<int>(second) };
+    c = std::move(b);
+    CHECK(c.get_allocator().arena() == &first);
+    CHECK(c.size() == 3);
+
+    // A copy stays in the destination's arena
+    Vector d{ ArenaAllocator<int>(second) };
+    d = c;
+    CHECK(d.get_allocator().arena() == &second);
+    CHECK(d == c);
+}
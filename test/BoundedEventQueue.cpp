@@ -0,0 +1,224 @@
+#include "BoundedEventQueue.h"
+#include "Event.h"
+#include "Observer.h"
+
+#include "GarageDoorSM.h"
+
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+using tsm::BoundedEventQueueT;
+using tsm::Event;
+using tsm::OverflowPolicy;
+
+template<OverflowPolicy Policy>
+using SmallQueue = BoundedEventQueueT<Event, std::mutex, 4, Policy>;
+
+TEST_CASE("TestBoundedEventQueue - testFifoOrder")
+{
+    SmallQueue<OverflowPolicy::Reject> eq_;
+    for (tsm::event_id_t i = 0; i < 4; ++i) {
+        REQUIRE(eq_.addEvent(Event(i)));
+    }
+    for (tsm::event_id_t i = 0; i < 4; ++i) {
+        CHECK(eq_.nextEvent().id == i);
+    }
+    CHECK(eq_.size() == 0);
+}
+
+TEST_CASE("TestBoundedEventQueue - testReject")
+{
+    SmallQueue<OverflowPolicy::Reject> eq_;
+    for (tsm::event_id_t i = 0; i < 6; ++i) {
+        eq_.addEvent(Event(i));
+    }
+    CHECK(eq_.size() == 4);
+    CHECK(eq_.rejectedCount() == 2);
+    CHECK(eq_.droppedCount() == 0);
+    CHECK(eq_.nextEvent().id == 0);
+}
+
+TEST_CASE("TestBoundedEventQueue - testDropOldest")
+{
+    SmallQueue<OverflowPolicy::DropOldest> eq_;
+    for (tsm::event_id_t i = 0; i < 6; ++i) {
+        REQUIRE(eq_.addEvent(Event(i)));
+    }
+    CHECK(eq_.droppedCount() == 2);
+    for (tsm::event_id_t i = 2; i < 6; ++i) {
+        CHECK(eq_.nextEvent().id == i);
+    }
+}
+
+TEST_CASE("TestBoundedEventQueue - testDropNewest")
+{
+    SmallQueue<OverflowPolicy::DropNewest> eq_;
+    for (tsm::event_id_t i = 0; i < 6; ++i) {
+        eq_.addEvent(Event(i));
+    }
+    CHECK(eq_.droppedCount() == 2);
+    for (tsm::event_id_t i = 0; i < 4; ++i) {
+        CHECK(eq_.nextEvent().id == i);
+    }
+}
+
+TEST_CASE("TestBoundedEventQueue - testBlockUntilSpaceAvailable")
+{
+    SmallQueue<OverflowPolicy::Block> eq_;
+    for (tsm::event_id_t i = 0; i < 4; ++i) {
+        REQUIRE(eq_.addEvent(Event(i)));
+    }
+    // The fifth event can only go in once the consumer makes room
+    auto producer = std::async(std::launch::async,
+                               [&eq_] { return eq_.addEvent(Event(4)); });
+    for (tsm::event_id_t i = 0; i < 5; ++i) {
+        CHECK(eq_.nextEvent().id == i);
+    }
+    CHECK(producer.get());
+    CHECK(eq_.droppedCount() == 0);
+}
+
+TEST_CASE("TestBoundedEventQueue - testStopReleasesBlockedProducer")
+{
+    SmallQueue<OverflowPolicy::Block> eq_;
+    for (tsm::event_id_t i = 0; i < 4; ++i) {
+        REQUIRE(eq_.addEvent(Event(i)));
+    }
+    auto producer = std::async(std::launch::async,
+                               [&eq_] { return eq_.addEvent(Event(4)); });
+    eq_.stop();
+    CHECK_FALSE(producer.get());
+    CHECK(eq_.interrupted());
+}
+
+template<OverflowPolicy Policy>
+void
+checkStoppedQueueRefusesEvents()
+{
+    SmallQueue<Policy> eq_;
+    eq_.stop();
+    std::vector<Event> events{ Event(0), Event(1) };
+    CHECK_FALSE(eq_.addEvent(Event(0)));
+    CHECK(eq_.addEvents(events.begin(), events.end()) == 0);
+    CHECK(eq_.size() == 0);
+}
+
+TEST_CASE("TestBoundedEventQueue - testStoppedQueueRefusesEvents")
+{
+    checkStoppedQueueRefusesEvents<OverflowPolicy::Block>();
+    checkStoppedQueueRefusesEvents<OverflowPolicy::Reject>();
+    checkStoppedQueueRefusesEvents<OverflowPolicy::DropOldest>();
+    checkStoppedQueueRefusesEvents<OverflowPolicy::DropNewest>();
+}
+
+TEST_CASE("TestBoundedEventQueue - testNextEventWakesEveryBlockedProducer")
+{
+    using namespace std::chrono_literals;
+    SmallQueue<OverflowPolicy::Block> eq_;
+    for (tsm::event_id_t i = 0; i < 4; ++i) {
+        REQUIRE(eq_.addEvent(Event(i)));
+    }
+    // One producer waits for room for a whole range, another for one slot
+    std::vector<Event> range{ Event(5), Event(6), Event(7), Event(8) };
+    auto rangeProducer = std::async(std::launch::async, [&] {
+        return eq_.addEvents(range.begin(), range.end());
+    });
+    auto producer = std::async(std::launch::async,
+                               [&eq_] { return eq_.addEvent(Event(4)); });
+    std::this_thread::sleep_for(10ms);
+
+    // One free slot is not enough for the range, but must not be missed by
+    // the single event
+    CHECK(eq_.nextEvent().id == 0);
+    CHECK(producer.get());
+    std::deque<Event> batch;
+    CHECK(eq_.nextEvents(batch) == 4);
+    CHECK(rangeProducer.get() == 4);
+    CHECK(eq_.size() == 4);
+}
+
+TEST_CASE("TestBoundedEventQueue - testNextEventsReleasesBlockedProducer")
+{
+    SmallQueue<OverflowPolicy::Block> eq_;
+    for (tsm::event_id_t i = 0; i < 4; ++i) {
+        REQUIRE(eq_.addEvent(Event(i)));
+    }
+    auto producer = std::async(std::launch::async,
+                               [&eq_] { return eq_.addEvent(Event(4)); });
+    std::deque<Event> batch;
+    CHECK(eq_.nextEvents(batch) == 4);
+    CHECK(producer.get());
+    CHECK(eq_.nextEvents(batch, 1) == 1);
+    REQUIRE(batch.size() == 5);
+    CHECK(batch.back().id == 4);
+}
+
+TEST_CASE("TestBoundedEventQueue - testAddEventsRejectsWholeRange")
+{
+    SmallQueue<OverflowPolicy::Reject> eq_;
+    std::vector<Event> events{ Event(0), Event(1), Event(2) };
+    CHECK(eq_.addEvents(events.begin(), events.end()) == 3);
+    // Only one slot left, so the whole range is refused
+    CHECK(eq_.addEvents(events.begin(), events.end()) == 0);
+    CHECK(eq_.rejectedCount() == 3);
+    CHECK(eq_.size() == 3);
+}
+
+TEST_CASE("TestBoundedEventQueue - testAddEventsDropNewest")
+{
+    SmallQueue<OverflowPolicy::DropNewest> eq_;
+    std::vector<Event> events{ Event(0), Event(1), Event(2) };
+    CHECK(eq_.addEvents(events.begin(), events.end()) == 3);
+    CHECK(eq_.addEvents(events.begin(), events.end()) == 1);
+    CHECK(eq_.droppedCount() == 2);
+    std::deque<Event> batch;
+    CHECK(eq_.nextEvents(batch) == 4);
+    CHECK(batch.back().id == 0);
+}
+
+TEST_CASE("TestBoundedEventQueue - testAddEventsBlockLargerThanCapacity")
+{
+    SmallQueue<OverflowPolicy::Block> eq_;
+    std::vector<Event> events;
+    for (tsm::event_id_t i = 0; i < 10; ++i) {
+        events.emplace_back(i);
+    }
+    auto producer = std::async(std::launch::async, [&] {
+        return eq_.addEvents(events.begin(), events.end());
+    });
+    for (tsm::event_id_t i = 0; i < 10; ++i) {
+        CHECK(eq_.nextEvent().id == i);
+    }
+    CHECK(producer.get() == 10);
+}
+
+using tsm::BlockingObserver;
+using tsmtest::GarageDoorHsm;
+
+using BoundedGarageDoorHsm = tsm::AsyncExecWithObserver<
+  GarageDoorHsm,
+  BlockingObserver,
+  tsm::BoundedEventQueue<Event, 16, OverflowPolicy::Reject>>;
+
+TEST_CASE("TestBoundedEventQueue - testAsyncExecutionPolicyWithBoundedQueue")
+{
+    auto sm = std::make_shared<BoundedGarageDoorHsm>();
+
+    sm->startSM();
+
+    sm->wait();
+    REQUIRE(sm->getCurrentState() == &sm->DoorClosed);
+
+    REQUIRE(sm->sendEvent(sm->click_event));
+    sm->wait();
+    REQUIRE(sm->getCurrentState() == &sm->DoorOpening);
+
+    REQUIRE(sm->sendEvent(sm->sensor_hi_event));
+    sm->wait();
+    REQUIRE(sm->getCurrentState() == &sm->DoorOpen);
+
+    sm->stopSM();
+}
@@ -0,0 +1,162 @@
+#include "Event.h"
+#include "Hsm.h"
+#include "State.h"
+#include "tsm.h"
+
+#include <catch2/catch.hpp>
+
+#include <memory>
+
+using tsm::Event;
+using tsm::Hsm;
+using tsm::IHsm;
+using tsm::SingleThreadedHsm;
+using tsm::State;
+
+namespace tsmtest {
+
+// Root -> Outer -> Inner, three levels deep. Inner handles step, Outer
+// handles leave and Root handles reset.
+struct Root : public Hsm<Root>
+{
+    struct Outer : public Hsm<Outer>
+    {
+        struct Inner : public Hsm<Inner>
+        {
+            Inner()
+            {
+                setStartState(&a);
+                add(a, step, b);
+                add(b, step, a);
+            }
+
+            // Consumes hold events on their way up from a or b
+            bool execute(Event const& e) override
+            {
+                if (e == hold) {
+                    ++held;
+                    return true;
+                }
+                return false;
+            }
+
+            State a, b;
+            Event step, hold;
+            int held{};
+        };
+
+        Outer()
+        {
+            setStartState(&inner);
+            inner.setParent(this);
+            add(inner, leave, done);
+            add(done, enter, inner);
+        }
+
+        // Counts the events that reach Outer through handle()
+        void handle(Event const& e) override
+        {
+            ++handled;
+            Hsm<Outer>::handle(e);
+        }
+
+        Inner inner;
+        State done;
+        int handled{};
+        Event leave, enter;
+    };
+
+    Root()
+    {
+        setStartState(&outer);
+        outer.setParent(this);
+        add(outer, reset, idle);
+        add(idle, reset, outer);
+        add(outer, outer.inner.hold, idle);
+    }
+
+    Outer outer;
+    State idle;
+    Event reset;
+};
+
+} // namespace tsmtest
+
+using tsmtest::Root;
+
+static void
+runHierarchy(std::shared_ptr<SingleThreadedHsm<Root>> const& sm)
+{
+    auto& outer = sm->outer;
+    auto& inner = outer.inner;
+    sm->startSM();
+    REQUIRE(sm->getCurrentState() == &outer);
+    REQUIRE(outer.getCurrentState() == &inner);
+    REQUIRE(inner.getCurrentState() == &inner.a);
+
+    sm->sendEvent(inner.step);
+    sm->step();
+    REQUIRE(inner.getCurrentState() == &inner.b);
+
+    // Inner::execute consumes hold before Root's transition is reached
+    sm->sendEvent(inner.hold);
+    sm->step();
+    CHECK(inner.held == 1);
+    REQUIRE(sm->getCurrentState() == &outer);
+    REQUIRE(inner.getCurrentState() == &inner.b);
+
+    // Two levels up
+    sm->sendEvent(sm->reset);
+    sm->step();
+    REQUIRE(sm->getCurrentState() == &sm->idle);
+
+    sm->sendEvent(sm->reset);
+    sm->step();
+    REQUIRE(sm->getCurrentState() == &outer);
+    REQUIRE(inner.getCurrentState() == &inner.a);
+
+    // One level up
+    sm->sendEvent(outer.leave);
+    sm->step();
+    REQUIRE(outer.getCurrentState() == &outer.done);
+
+    sm->stopSM();
+}
+
+TEST_CASE("TestCompiledHsm - testEscalation")
+{
+    auto sm = std::make_shared<SingleThreadedHsm<Root>>();
+    runHierarchy(sm);
+    // hold, reset and leave were escalated from Inner one level at a time
+    CHECK(sm->outer.handled == 3);
+}
+
+TEST_CASE("TestCompiledHsm - testCompiledEscalation")
+{
+    auto sm = std::make_shared<SingleThreadedHsm<Root>>();
+    sm->outer.inner.compile();
+    sm->outer.compile();
+    runHierarchy(sm);
+    // Inner went straight to the owning transitions
+    CHECK(sm->outer.handled == 0);
+}
+
+TEST_CASE("TestCompiledHsm - testOpaqueAncestor")
+{
+    struct Opaque : public IHsm
+    {
+        void handle(Event const& e) override { last = e; }
+        Event last{ 0 };
+    };
+
+    Opaque top;
+    Root::Outer outer;
+    outer.setParent(&top);
+    outer.inner.compile();
+
+    outer.startSM();
+    Event unknown;
+    outer.inner.handle(unknown);
+    // Not handled by Outer, so it reaches the opaque parent via handle()
+    CHECK(top.last == unknown);
+}
@@ -0,0 +1,75 @@
+#include "CoroutineExecutionPolicy.h"
+#include "Event.h"
+
+#include "GarageDoorSM.h"
+
+#include <catch2/catch.hpp>
+
+#include <coroutine>
+#include <thread>
+#include <vector>
+
+using tsmtest::GarageDoorHsm;
+using CoroutineGarageDoorHsm = tsm::CoroutineExecutionPolicy<GarageDoorHsm>;
+
+TEST_CASE("TestCoroutineExecutionPolicy - testInlineScheduler")
+{
+    CoroutineGarageDoorHsm sm;
+    sm.startSM();
+    REQUIRE(sm.getCurrentState() == &sm.DoorClosed);
+
+    // The default scheduler processes the event on the sending thread
+    sm.sendEvent(sm.click_event);
+    REQUIRE(sm.getCurrentState() == &sm.DoorOpening);
+
+    sm.sendEvent(sm.sensor_hi_event);
+    REQUIRE(sm.getCurrentState() == &sm.DoorOpen);
+
+    sm.stopSM();
+}
+
+TEST_CASE("TestCoroutineExecutionPolicy - testEventLoopScheduler")
+{
+    // Stand-in for an external event loop: resumptions are queued and run
+    // when the loop gets round to them.
+    std::vector<std::coroutine_handle<>> ready;
+    auto runReady = [&ready] {
+        while (!ready.empty()) {
+            auto h = ready.back();
+            ready.pop_back();
+            h.resume();
+        }
+    };
+
+    CoroutineGarageDoorHsm sm;
+    sm.setScheduler([&ready](std::coroutine_handle<> h) { ready.push_back(h); });
+    sm.startSM();
+    runReady();
+    REQUIRE(sm.getCurrentState() == &sm.DoorClosed);
+
+    std::vector<tsm::Event> events{ sm.click_event, sm.sensor_hi_event };
+    CHECK(sm.sendEvents(events.begin(), events.end()) == 2);
+    CHECK(ready.size() == 1);
+    // Nothing happens until the loop runs the machine
+    CHECK(sm.getCurrentState() == &sm.DoorClosed);
+    runReady();
+    REQUIRE(sm.getCurrentState() == &sm.DoorOpen);
+
+    sm.sendEvent(sm.click_event);
+    sm.stopSM();
+    runReady();
+    CHECK(sm.getCurrentState() == nullptr);
+}
+
+TEST_CASE("TestCoroutineExecutionPolicy - testResumeOnAnotherThread")
+{
+    CoroutineGarageDoorHsm sm;
+    sm.setScheduler([](std::coroutine_handle<> h) {
+        std::thread t([h] { h.resume(); });
+        t.join();
+    });
+    sm.startSM();
+    sm.sendEvent(sm.click_event);
+    REQUIRE(sm.getCurrentState() == &sm.DoorOpening);
+    sm.stopSM();
+}
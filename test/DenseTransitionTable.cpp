@@ -0,0 +1,246 @@
+#include "DenseTransitionTable.h"
+#include "Event.h"
+#include "Hsm.h"
+#include "State.h"
+#include "tsm.h"
+
+#include <catch2/catch.hpp>
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+using tsm::DenseStateTransitionTableT;
+using tsm::Event;
+using tsm::Hsm;
+using tsm::SingleThreadedHsm;
+using tsm::State;
+
+namespace tsmtest {
+
+struct DenseGarageDoorHsm
+  : public Hsm<DenseGarageDoorHsm, DenseStateTransitionTableT>
+{
+    DenseGarageDoorHsm()
+    {
+        setStartState(&DoorClosed);
+
+        add(DoorClosed, click_event, DoorOpening);
+        add(DoorOpening, sensor_hi_event, DoorOpen);
+        add(DoorOpen, click_event, DoorClosing);
+        add(DoorClosing, sensor_hi_event, DoorClosed);
+        add(DoorOpening, click_event, DoorStoppedOpening);
+        add(DoorStoppedOpening, click_event, DoorClosing);
+        add(DoorClosing, obstruct_event, DoorStoppedClosing);
+        add(DoorClosing, click_event, DoorStoppedClosing);
+        add(DoorStoppedClosing, click_event, DoorOpening);
+        add(DoorClosed, click_event, DoorOpening);
+    }
+
+    State DoorOpen, DoorOpening, DoorClosing, DoorClosed, DoorStoppedClosing,
+      DoorStoppedOpening;
+
+    Event click_event, sensor_lo_event, sensor_hi_event, obstruct_event;
+};
+
+struct CountingState : public State
+{
+    void onEntry(Event const&) override { ++entries; }
+    void onExit(Event const&) override { ++exits; }
+    int entries{};
+    int exits{};
+};
+
+struct InternalHsm : public Hsm<InternalHsm, DenseStateTransitionTableT>
+{
+    InternalHsm()
+    {
+        setStartState(&Idle);
+        add(Idle, tick_event, Idle);
+        addInternal(Idle, ping_event, [this](Event const&) { ++pings; });
+        addInternal(
+          Idle,
+          stop_event,
+          [this](Event const&) { ++pings; },
+          [this](Event const&) { return pings < 2; });
+    }
+
+    CountingState Idle;
+    Event tick_event, ping_event, stop_event;
+    int pings{};
+};
+
+} // namespace tsmtest
+
+using tsmtest::DenseGarageDoorHsm;
+using tsmtest::InternalHsm;
+
+TEST_CASE("TestDenseTransitionTable - testGarageDoor")
+{
+    auto sm = std::make_shared<SingleThreadedHsm<DenseGarageDoorHsm>>();
+    sm->startSM();
+    REQUIRE(sm->getCurrentState() == &sm->DoorClosed);
+
+    sm->sendEvent(sm->click_event);
+    sm->step();
+    REQUIRE(sm->getCurrentState() == &sm->DoorOpening);
+
+    sm->sendEvent(sm->sensor_hi_event);
+    sm->step();
+    REQUIRE(sm->getCurrentState() == &sm->DoorOpen);
+
+    sm->sendEvent(sm->click_event);
+    sm->step();
+    REQUIRE(sm->getCurrentState() == &sm->DoorClosing);
+
+    sm->sendEvent(sm->obstruct_event);
+    sm->step();
+    REQUIRE(sm->getCurrentState() == &sm->DoorStoppedClosing);
+
+    // No transition for this event, the state does not change
+    sm->sendEvent(sm->sensor_lo_event);
+    sm->step();
+    REQUIRE(sm->getCurrentState() == &sm->DoorStoppedClosing);
+
+    sm->stopSM();
+}
+
+TEST_CASE("TestDenseTransitionTable - testLookup")
+{
+    DenseStateTransitionTableT<DenseGarageDoorHsm> table;
+    std::vector<std::unique_ptr<State>> states;
+    for (int i = 0; i < 20; i++) {
+        states.emplace_back(new State());
+    }
+    // Sparse and out of order event ids, more events than the initial stride
+    std::vector<Event> events;
+    for (tsm::event_id_t id : { 500U, 3U, 70000U, 4U, 9U, 10U, 11U, 12U, 13U,
+                                14U, 15U, 16U }) {
+        events.emplace_back(id);
+    }
+
+    for (std::size_t s = 0; s < states.size(); s++) {
+        for (std::size_t e = 0; e < events.size(); e++) {
+            if ((s + e) % 3 == 0) {
+                table.add(*states[s], events[e], *states[(s + e) % 20]);
+            }
+        }
+    }
+    CHECK(table.stateCount() == 20);
+    CHECK(table.eventCount() == events.size());
+    CHECK(table.getEvents().size() == events.size());
+
+    for (std::size_t s = 0; s < states.size(); s++) {
+        for (std::size_t e = 0; e < events.size(); e++) {
+            auto* t = table.next(*states[s], events[e]);
+            if ((s + e) % 3 == 0) {
+                REQUIRE(t != nullptr);
+                CHECK(&table.target(*t) == states[(s + e) % 20].get());
+            } else {
+                CHECK(t == nullptr);
+            }
+        }
+    }
+
+    State unknownState;
+    CHECK(table.next(unknownState, events[0]) == nullptr);
+    CHECK(table.next(*states[0], Event(2)) == nullptr);
+    CHECK(table.next(*states[0], Event(100000)) == nullptr);
+
+    // The first transition added for a pair wins
+    table.add(*states[0], events[0], unknownState);
+    CHECK(&table.target(*table.next(*states[0], events[0])) == states[0].get());
+}
+
+TEST_CASE("TestDenseTransitionTable - testInternalTransition")
+{
+    // The default table has no internal transitions; Hsm::addInternal
+    // static_asserts on it
+    CHECK(tsm::HasInternalTransitions<
+          DenseStateTransitionTableT<InternalHsm>>::value);
+    CHECK_FALSE(tsm::HasInternalTransitions<
+                tsm::StateTransitionTableT<InternalHsm>>::value);
+
+    InternalHsm sm;
+    sm.startSM();
+    CHECK(sm.Idle.entries == 1);
+
+    // A self transition leaves and re-enters the state
+    sm.handle(sm.tick_event);
+    CHECK(sm.Idle.exits == 1);
+    CHECK(sm.Idle.entries == 2);
+
+    // An internal one only runs its action
+    sm.handle(sm.ping_event);
+    CHECK(sm.pings == 1);
+    sm.handle(sm.stop_event);
+    CHECK(sm.pings == 2);
+    sm.handle(sm.stop_event);
+    CHECK(sm.pings == 2);
+    CHECK(sm.Idle.exits == 1);
+    CHECK(sm.Idle.entries == 2);
+    CHECK(sm.getCurrentState() == &sm.Idle);
+    sm.stopSM();
+}
+
+TEST_CASE("TestDenseTransitionTable - testPackedRecords")
+{
+    DenseStateTransitionTableT<DenseGarageDoorHsm> table;
+    State a, b;
+    Event e1(1), e2(2);
+    table.add(a, e1, b);
+    table.add(b, e2, a, [](Event const&) {});
+    CHECK(sizeof(*table.next(a, e1)) == 8);
+    CHECK(&table.target(*table.next(b, e2)) == &a);
+    // Two records and two rows of the initial 8 wide stride
+    CHECK(table.tableBytes() == 2 * 8 + 2 * 8 * sizeof(uint16_t));
+}
+
+TEST_CASE("TestDenseTransitionTable - testFarApartIds")
+{
+    tsm::DenseIndex index;
+    CHECK(index.insert(10) == 0);
+    CHECK(index.insert(11) == 1);
+    CHECK(index.insert(3) == 2);
+    // Too far from the others for the flat array
+    CHECK(index.insert(5000000) == 3);
+    CHECK(index.insert(4000000000U) == 4);
+    CHECK(index.insert(5000000) == 3);
+    CHECK(index.find(4000000000U) == 4);
+    CHECK(index.find(12) == tsm::DenseIndex::NONE);
+    CHECK(index.find(5000001) == tsm::DenseIndex::NONE);
+    CHECK(index.size() == 5);
+    CHECK(index.span() == 9);
+    CHECK(index.outliers() == 2);
+
+    // Runtime and enum events in one table are 2^31 ids apart
+    DenseStateTransitionTableT<DenseGarageDoorHsm> table;
+    State a, b;
+    Event runtime(7), enumEvent(tsm::ENUM_EVENT_BASE + 1);
+    table.add(a, runtime, b);
+    table.add(b, enumEvent, a);
+    CHECK(&table.target(*table.next(a, runtime)) == &b);
+    CHECK(&table.target(*table.next(b, enumEvent)) == &a);
+    CHECK(table.next(a, enumEvent) == nullptr);
+    CHECK(table.eventCount() == 2);
+}
+
+TEST_CASE("TestDenseTransitionTable - testTooManyTransitions")
+{
+    using Table = DenseStateTransitionTableT<DenseGarageDoorHsm>;
+    Table table;
+    State a, b;
+    const std::size_t MAX = tsm::PackedTransitions<DenseGarageDoorHsm,
+                                                   std::allocator<char>>::
+      MAX_TRANSITIONS;
+    tsm::event_id_t id = 1;
+    for (; id <= MAX; ++id) {
+        table.add(a, Event(id), b);
+    }
+    // Adding to a full cell adds nothing, so it is still fine
+    table.add(a, Event(1), a);
+    CHECK(&table.target(*table.next(a, Event(1))) == &b);
+    CHECK_THROWS_AS(table.add(a, Event(id), b), std::length_error);
+    CHECK(table.next(a, Event(id)) == nullptr);
+    CHECK(&table.target(*table.next(a, Event(id - 1))) == &b);
+}
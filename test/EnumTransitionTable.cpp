@@ -0,0 +1,188 @@
+#include "EnumTransitionTable.h"
+#include "Event.h"
+#include "EventQueue.h"
+#include "Hsm.h"
+#include "OrthogonalHsm.h"
+#include "State.h"
+#include "tsm.h"
+
+#include <catch2/catch.hpp>
+
+#include <memory>
+#include <mutex>
+#include <type_traits>
+
+using tsm::EnumEvents;
+using tsm::EnumTransitionTable;
+using tsm::Event;
+using tsm::Hsm;
+using tsm::OrthogonalHsm;
+using tsm::SingleThreadedHsm;
+using tsm::State;
+
+namespace tsmtest {
+
+enum class DoorEvent
+{
+    Click,
+    SensorHi,
+    SensorLo,
+    Obstruct,
+    Count
+};
+
+struct EnumGarageDoorHsm
+  : public Hsm<EnumGarageDoorHsm, EnumTransitionTable<DoorEvent>::Table>
+{
+    EnumGarageDoorHsm()
+    {
+        setStartState(&DoorClosed);
+
+        add(DoorClosed, DoorEvent::Click, DoorOpening);
+        add(DoorOpening, DoorEvent::SensorHi, DoorOpen);
+        add(DoorOpen, DoorEvent::Click, DoorClosing);
+        add(DoorClosing, DoorEvent::SensorHi, DoorClosed);
+        add(DoorOpening, DoorEvent::Click, DoorStoppedOpening);
+        add(DoorStoppedOpening, DoorEvent::Click, DoorClosing);
+        add(DoorClosing, DoorEvent::Obstruct, DoorStoppedClosing);
+        add(DoorClosing, DoorEvent::Click, DoorStoppedClosing);
+        add(DoorStoppedClosing, DoorEvent::Click, DoorOpening);
+    }
+
+    State DoorOpen, DoorOpening, DoorClosing, DoorClosed, DoorStoppedClosing,
+      DoorStoppedOpening;
+};
+
+enum class PowerEvent
+{
+    Power,
+    Speed,
+    Count
+};
+
+template<int N>
+struct PowerRegion
+  : public Hsm<PowerRegion<N>, EnumTransitionTable<PowerEvent>::Table>
+{
+    PowerRegion()
+    {
+        this->setStartState(&off);
+        this->add(off, PowerEvent::Power, on);
+        this->add(on, PowerEvent::Power, off);
+    }
+
+    State off, on;
+};
+
+} // namespace tsmtest
+
+using tsmtest::DoorEvent;
+using tsmtest::EnumGarageDoorHsm;
+using tsmtest::PowerEvent;
+using tsmtest::PowerRegion;
+
+static_assert(EnumEvents<DoorEvent>::COUNT == 4, "Four door events");
+static_assert(EnumEvents<DoorEvent>::contains(DoorEvent::Obstruct),
+              "Obstruct is a door event");
+static_assert(!EnumEvents<DoorEvent>::contains(DoorEvent::Count),
+              "Count is not a door event");
+static_assert(std::is_same<EnumGarageDoorHsm::event_enum, DoorEvent>::value,
+              "The machine knows its event enum");
+
+// Plain enums keep their values as ids, and no enum converts implicitly
+enum LegacyEvents
+{
+    EV_START = 7
+};
+static_assert(!tsm::IsEventEnum<LegacyEvents>::value, "A plain enum is not");
+static_assert(tsm::IsEventEnum<DoorEvent>::value, "A scoped enum with Count is");
+static_assert(!std::is_convertible<DoorEvent, Event>::value,
+              "Enum events are explicit");
+
+TEST_CASE("TestEnumTransitionTable - testGarageDoor")
+{
+    auto sm = std::make_shared<SingleThreadedHsm<EnumGarageDoorHsm>>();
+    sm->startSM();
+    REQUIRE(sm->getCurrentState() == &sm->DoorClosed);
+    CHECK(sm->stateCount() == 6);
+    CHECK(sm->eventCount() == 3);
+
+    sm->sendEvent(Event(DoorEvent::Click));
+    sm->step();
+    REQUIRE(sm->getCurrentState() == &sm->DoorOpening);
+
+    sm->sendEvent(Event(DoorEvent::SensorHi));
+    sm->step();
+    REQUIRE(sm->getCurrentState() == &sm->DoorOpen);
+
+    sm->handle(DoorEvent::Click);
+    REQUIRE(sm->getCurrentState() == &sm->DoorClosing);
+
+    sm->handle(DoorEvent::Obstruct);
+    REQUIRE(sm->getCurrentState() == &sm->DoorStoppedClosing);
+
+    // Not in the table, and ids outside the enum are not looked up
+    sm->handle(DoorEvent::SensorLo);
+    sm->handle(Event(7));
+    REQUIRE(sm->getCurrentState() == &sm->DoorStoppedClosing);
+
+    CHECK(sm->eventIndex(DoorEvent::Click) == 0);
+    CHECK(sm->eventIndex(DoorEvent::Obstruct) == 2);
+    CHECK(sm->eventIndex(DoorEvent::SensorLo) ==
+          std::size_t(tsm::DenseIndex::NONE));
+    CHECK(sm->eventIndex(Event(7)) == std::size_t(tsm::DenseIndex::NONE));
+    CHECK(Event(EV_START).id == 7);
+
+    sm->stopSM();
+}
+
+TEST_CASE("TestEnumTransitionTable - testOrthogonalRoutes")
+{
+    using Regions = OrthogonalHsm<PowerRegion<0>, PowerRegion<1>>;
+    static_assert(std::is_same<tsm::CommonEventEnum<PowerRegion<0>,
+                                                    PowerRegion<1>>::type,
+                               PowerEvent>::value,
+                  "Regions share an event enum");
+    static_assert(
+      std::is_void<
+        tsm::CommonEventEnum<PowerRegion<0>, EnumGarageDoorHsm>::type>::value,
+      "Regions with different enums do not");
+
+    Regions sm;
+    sm.setDelivery(tsm::RegionDelivery::Broadcast);
+    sm.dispatch(Event(PowerEvent::Power));
+    CHECK(std::get<0>(sm.sms_).getCurrentState() == &std::get<0>(sm.sms_).on);
+    CHECK(std::get<1>(sm.sms_).getCurrentState() == &std::get<1>(sm.sms_).on);
+
+    sm.setDelivery(tsm::RegionDelivery::First);
+    sm.dispatch(Event(PowerEvent::Power));
+    CHECK(std::get<0>(sm.sms_).getCurrentState() == &std::get<0>(sm.sms_).off);
+    CHECK(std::get<1>(sm.sms_).getCurrentState() == &std::get<1>(sm.sms_).on);
+}
+
+TEST_CASE("TestEnumTransitionTable - testQueueCoalescing")
+{
+    tsm::EventQueueT<Event, std::mutex, tsm::BlockingWait, DoorEvent> eq_;
+    eq_.setCoalescable(Event(DoorEvent::SensorHi));
+    // Not an enum event, so it cannot be marked
+    eq_.setCoalescable(Event(7));
+
+    eq_.addEvent(Event(DoorEvent::SensorHi, 1));
+    eq_.addEvent(Event(DoorEvent::Click));
+    eq_.addEvent(Event(DoorEvent::SensorHi, 2));
+    eq_.addEvent(Event(7));
+    eq_.addEvent(Event(7));
+
+    Event e = eq_.nextEvent();
+    CHECK(e == Event(DoorEvent::SensorHi));
+    CHECK(e.data == 2);
+    CHECK(eq_.nextEvent() == Event(DoorEvent::Click));
+    CHECK(eq_.nextEvent().id == 7);
+    CHECK(eq_.nextEvent().id == 7);
+
+    eq_.setCoalescable(Event(DoorEvent::SensorHi), tsm::Coalesce::None);
+    eq_.addEvent(Event(DoorEvent::SensorHi));
+    eq_.addEvent(Event(DoorEvent::SensorHi));
+    std::deque<Event> batch;
+    CHECK(eq_.nextEvents(batch) == 2);
+}
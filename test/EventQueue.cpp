@@ -54,3 +54,163 @@ TEST_CASE("TestEventQueue - testAddFrom100Threads")
         t.join();
     }
 }
+
+TEST_CASE("TestEventQueue - testNextEventsBatch")
+{
+    EventQueue eq_;
+    const tsm::event_id_t NEVENTS = 10;
+    for (tsm::event_id_t i = 0; i < NEVENTS; i++) {
+        eq_.addEvent(Event(i));
+    }
+
+    std::deque<Event> batch;
+    CHECK(eq_.nextEvents(batch, 4) == 4);
+    CHECK(eq_.nextEvents(batch) == NEVENTS - 4);
+    REQUIRE(batch.size() == NEVENTS);
+    for (tsm::event_id_t i = 0; i < NEVENTS; i++) {
+        CHECK(batch[i].id == i);
+    }
+
+    eq_.stop();
+    CHECK(eq_.nextEvents(batch) == 0);
+}
+
+TEST_CASE("TestEventQueue - testAddEventsKeepsRangesContiguous")
+{
+    EventQueue eq_;
+    const int NEVENTS = 100;
+    std::vector<Event> a, b;
+    for (int i = 0; i < NEVENTS; i++) {
+        a.emplace_back(1, i);
+        b.emplace_back(2, i);
+    }
+
+    std::thread ta([&] { CHECK(eq_.addEvents(a.begin(), a.end()) == a.size()); });
+    std::thread tb([&] { CHECK(eq_.addEvents(b.begin(), b.end()) == b.size()); });
+    ta.join();
+    tb.join();
+
+    for (int range = 0; range < 2; range++) {
+        Event first = eq_.nextEvent();
+        CHECK(first.data == 0);
+        for (int i = 1; i < NEVENTS; i++) {
+            Event e = eq_.nextEvent();
+            CHECK(e.id == first.id);
+            CHECK(e.data == static_cast<tsm::event_data_t>(i));
+        }
+    }
+}
+
+using SpinningEventQueue =
+  tsm::EventQueueT<tsm::Event, std::mutex, tsm::SpinThenParkWait<100, 10>>;
+
+TEST_CASE("TestEventQueue - testSpinThenParkWait")
+{
+    SpinningEventQueue eq_;
+    const int NEVENTS = 1000;
+
+    // The consumer spins, yields and then parks while the producer trickles
+    // events in, so every path through the wait strategy gets exercised.
+    auto consumer = std::async(std::launch::async, [&eq_] {
+        int n = 0;
+        for (int i = 0; i < NEVENTS; i++) {
+            if (eq_.nextEvent().data == static_cast<tsm::event_data_t>(i)) {
+                n++;
+            }
+        }
+        return n;
+    });
+    for (int i = 0; i < NEVENTS; i++) {
+        eq_.addEvent(Event(1, i));
+        if (i % 100 == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    CHECK(consumer.get() == NEVENTS);
+}
+
+TEST_CASE("TestEventQueue - testStopWakesSpinningConsumer")
+{
+    SpinningEventQueue eq_;
+    auto f1 =
+      std::async(std::launch::async, &SpinningEventQueue::nextEvent, &eq_);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    eq_.stop();
+    f1.get();
+    CHECK(eq_.interrupted());
+}
+
+TEST_CASE("TestEventQueue - testCoalesceReplaceData")
+{
+    EventQueue eq_;
+    Event tick(1), other(2);
+    eq_.setCoalescable(tick);
+
+    eq_.addEvent(Event(tick.id, 10));
+    eq_.addEvent(other);
+    eq_.addEvent(Event(tick.id, 11));
+    // Merged into the pending tick, which counts as queued
+    CHECK(eq_.addEvent(Event(tick.id, 12)));
+
+    // The pending tick keeps its place in the queue but takes the latest data
+    Event e = eq_.nextEvent();
+    CHECK(e.id == tick.id);
+    CHECK(e.data == 12);
+    CHECK(eq_.nextEvent().id == other.id);
+
+    // Once it has been taken, the next tick is queued again
+    eq_.addEvent(Event(tick.id, 13));
+    e = eq_.nextEvent();
+    CHECK(e.id == tick.id);
+    CHECK(e.data == 13);
+}
+
+TEST_CASE("TestEventQueue - testCoalesceKeepPending")
+{
+    EventQueue eq_;
+    Event tick(1);
+    eq_.setCoalescable(tick, tsm::Coalesce::KeepPending);
+
+    std::vector<Event> events;
+    for (tsm::event_data_t i = 0; i < 10; i++) {
+        events.emplace_back(tick.id, i);
+        events.emplace_back(2, i);
+    }
+    CHECK(eq_.addEvents(events.begin(), events.end()) == 11);
+
+    std::deque<Event> batch;
+    CHECK(eq_.nextEvents(batch) == 11);
+    CHECK(batch.front().id == tick.id);
+    CHECK(batch.front().data == 0);
+
+    // Draining the queue resets pending ticks
+    CHECK(eq_.addEvent(Event(tick.id, 5)));
+    // Dropped: the tick above is still queued
+    CHECK_FALSE(eq_.addEvent(Event(tick.id, 6)));
+    CHECK(eq_.nextEvent().data == 5);
+}
+
+TEST_CASE("TestEventQueue - testCoalesceWithAddFront")
+{
+    EventQueue eq_;
+    Event tick(1);
+    eq_.setCoalescable(tick);
+
+    eq_.addEvent(Event(2));
+    eq_.addFront(Event(tick.id, 1));
+    eq_.addEvent(Event(tick.id, 2));
+    eq_.addEvent(Event(3));
+
+    Event e = eq_.nextEvent();
+    CHECK(e.id == tick.id);
+    CHECK(e.data == 2);
+    CHECK(eq_.nextEvent().id == 2);
+    CHECK(eq_.nextEvent().id == 3);
+
+    // No longer coalescable
+    eq_.setCoalescable(tick, tsm::Coalesce::None);
+    eq_.addEvent(tick);
+    eq_.addEvent(tick);
+    std::deque<Event> batch;
+    CHECK(eq_.nextEvents(batch) == 2);
+}
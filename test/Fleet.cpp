@@ -0,0 +1,240 @@
+#include "Event.h"
+#include "Fleet.h"
+#include "MachineDefinition.h"
+#include "tsm.h"
+
+#include <catch2/catch.hpp>
+
+#include <random>
+#include <vector>
+
+using tsm::Event;
+using tsm::Fleet;
+using tsm::instance_id_t;
+using tsm::MachineDefinition;
+
+namespace tsmtest {
+
+enum class TrackerState
+{
+    Idle,
+    Moving,
+    Lost,
+    Count
+};
+
+enum class TrackerEvent
+{
+    Move,
+    Stop,
+    Timeout,
+    Count
+};
+
+// No per-device data, only the state
+struct NoContext
+{};
+
+struct TrackerDef
+{
+    using Context = NoContext;
+    using States = TrackerState;
+    static constexpr TrackerState initial = TrackerState::Idle;
+
+    static void define(MachineDefinition<TrackerDef>& d)
+    {
+        d.add(TrackerState::Idle, TrackerEvent::Move, TrackerState::Moving);
+        d.add(TrackerState::Moving, TrackerEvent::Stop, TrackerState::Idle);
+        d.add(TrackerState::Moving, TrackerEvent::Timeout, TrackerState::Lost);
+        d.add(TrackerState::Lost, TrackerEvent::Move, TrackerState::Moving);
+    }
+};
+
+constexpr TrackerState TrackerDef::initial;
+
+struct Odometer
+{
+    int trips{};
+};
+
+struct OdometerDef
+{
+    using Context = Odometer;
+    using States = TrackerState;
+    static constexpr TrackerState initial = TrackerState::Idle;
+
+    static void define(MachineDefinition<OdometerDef>& d)
+    {
+        d.add(TrackerState::Idle,
+              TrackerEvent::Move,
+              TrackerState::Moving,
+              [](Odometer& o, Event const&) { ++o.trips; });
+        d.add(TrackerState::Moving, TrackerEvent::Stop, TrackerState::Idle);
+    }
+};
+
+constexpr TrackerState OdometerDef::initial;
+
+} // namespace tsmtest
+
+using tsmtest::Odometer;
+using tsmtest::OdometerDef;
+using tsmtest::TrackerDef;
+using tsmtest::TrackerEvent;
+using tsmtest::TrackerState;
+
+TEST_CASE("TestFleet - testDispatch")
+{
+    Fleet<TrackerDef> fleet(1000000);
+    REQUIRE(fleet.size() == 1000000);
+    CHECK(fleet.count(TrackerState::Idle) == 1000000);
+
+    std::size_t taken = 0;
+    for (instance_id_t i = 0; i < fleet.size(); i += 2) {
+        taken += fleet.dispatch(i, TrackerEvent::Move) ? 1 : 0;
+    }
+    for (instance_id_t i = 0; i < fleet.size(); i += 4) {
+        taken += fleet.dispatch(i, TrackerEvent::Timeout) ? 1 : 0;
+    }
+    CHECK(taken == 750000);
+    // No transition from Idle on Stop
+    CHECK_FALSE(fleet.dispatch(1, TrackerEvent::Stop));
+
+    CHECK(fleet.count(TrackerState::Idle) == 500000);
+    CHECK(fleet.count(TrackerState::Moving) == 250000);
+    CHECK(fleet.count(TrackerState::Lost) == 250000);
+    CHECK(fleet.is(4, TrackerState::Lost));
+    CHECK(fleet.getState(6) == TrackerState::Moving);
+    CHECK(fleet.states()[7] ==
+          MachineDefinition<TrackerDef>::index(TrackerState::Idle));
+
+    std::size_t lost = 0;
+    std::size_t misplaced = 0;
+    fleet.forEach([&](instance_id_t id, TrackerState s, auto&) {
+        if (s == TrackerState::Lost) {
+            misplaced += id % 4 == 0 ? 0 : 1;
+            ++lost;
+        }
+    });
+    CHECK(lost == 250000);
+    CHECK(misplaced == 0);
+}
+
+TEST_CASE("TestFleet - testContexts")
+{
+    Fleet<OdometerDef> fleet;
+    const instance_id_t a = fleet.add();
+    const instance_id_t b = fleet.add(Odometer{ 10 });
+    CHECK(a == 0);
+    CHECK(b == 1);
+
+    fleet.dispatch(a, TrackerEvent::Move);
+    fleet.dispatch(a, TrackerEvent::Stop);
+    fleet.dispatch(a, TrackerEvent::Move);
+    fleet.dispatch(b, TrackerEvent::Move);
+
+    CHECK(fleet.context(a).trips == 2);
+    CHECK(fleet.context(b).trips == 11);
+    CHECK(fleet.is(a, TrackerState::Moving));
+}
+
+TEST_CASE("TestFleet - testStep")
+{
+    Fleet<TrackerDef> fleet(1001);
+    std::vector<instance_id_t> ids;
+    std::vector<Event> events;
+    for (instance_id_t i = 0; i < fleet.size(); ++i) {
+        ids.push_back(i);
+        // Every third instance gets an event the machine does not know
+        events.push_back(i % 3 == 2 ? Event(7) : Event(TrackerEvent::Move));
+    }
+    CHECK(fleet.step(ids.data(), events.data(), ids.size()) == 668);
+    CHECK(fleet.count(TrackerState::Moving) == 668);
+    CHECK(fleet.is(2, TrackerState::Idle));
+    CHECK(fleet.is(1000, TrackerState::Moving));
+
+    // The same event for all; Idle has no Timeout transition
+    CHECK(fleet.step(ids.data(), ids.size(), TrackerEvent::Timeout) == 668);
+    CHECK(fleet.count(TrackerState::Lost) == 668);
+
+    // A batch that is not a multiple of the gather width, out of order
+    const instance_id_t some[] = { 1000, 3, 0, 999, 2 };
+    CHECK(fleet.step(some, 5, TrackerEvent::Move) == 5);
+    CHECK(fleet.is(1000, TrackerState::Moving));
+    CHECK(fleet.is(3, TrackerState::Moving));
+    CHECK(fleet.is(2, TrackerState::Moving));
+    CHECK(fleet.is(1, TrackerState::Lost));
+    CHECK(fleet.is(998, TrackerState::Idle));
+}
+
+TEST_CASE("TestFleet - testStepCallsActions")
+{
+    Fleet<OdometerDef> fleet(20);
+    std::vector<instance_id_t> ids;
+    for (instance_id_t i = 0; i < fleet.size(); i += 2) {
+        ids.push_back(i);
+    }
+    // Idle to Moving has an action, Moving to Idle does not
+    CHECK(fleet.step(ids.data(), ids.size(), TrackerEvent::Move) == 10);
+    CHECK(fleet.step(ids.data(), ids.size(), TrackerEvent::Stop) == 10);
+    CHECK(fleet.step(ids.data(), ids.size(), TrackerEvent::Move) == 10);
+    for (instance_id_t i = 0; i < fleet.size(); ++i) {
+        CHECK(fleet.context(i).trips == (i % 2 == 0 ? 2 : 0));
+        CHECK(fleet.is(i, i % 2 == 0 ? TrackerState::Moving
+                                     : TrackerState::Idle));
+    }
+}
+
+TEST_CASE("TestFleet - testStepRepeatedIds")
+{
+    // One instance several times in a chunk takes its events in order
+    Fleet<TrackerDef> fleet(8);
+    const instance_id_t ids[] = { 5, 5, 1, 5, 5 };
+    const Event events[] = { Event(TrackerEvent::Move),
+                             Event(TrackerEvent::Timeout),
+                             Event(TrackerEvent::Move),
+                             Event(TrackerEvent::Move),
+                             Event(TrackerEvent::Stop) };
+    CHECK(fleet.step(ids, events, 5) == 5);
+    CHECK(fleet.is(5, TrackerState::Idle));
+    CHECK(fleet.is(1, TrackerState::Moving));
+
+    Fleet<OdometerDef> odometers(4);
+    const instance_id_t same[] = { 2, 2, 2 };
+    const Event moves[] = { Event(TrackerEvent::Move),
+                            Event(TrackerEvent::Stop),
+                            Event(TrackerEvent::Move) };
+    CHECK(odometers.step(same, moves, 3) == 3);
+    CHECK(odometers.context(2).trips == 2);
+    CHECK(odometers.is(2, TrackerState::Moving));
+}
+
+TEST_CASE("TestFleet - testStepMatchesDispatch")
+{
+    // Random batches, repeats included, give what dispatching one event at a
+    // time in batch order gives
+    const std::size_t N = 64;
+    Fleet<OdometerDef> stepped(N);
+    Fleet<OdometerDef> dispatched(N);
+    std::mt19937 random(7);
+    std::uniform_int_distribution<instance_id_t> anyId(0, N - 1);
+    std::uniform_int_distribution<int> anyEvent(0, 3);
+    std::vector<instance_id_t> ids(101);
+    std::vector<Event> events(ids.size());
+    for (int round = 0; round < 50; ++round) {
+        std::size_t taken = 0;
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            ids[i] = anyId(random);
+            // 3 is not one of the machine's events
+            const int e = anyEvent(random);
+            events[i] = e == 3 ? Event(7)
+                               : Event(static_cast<TrackerEvent>(e));
+            taken += dispatched.dispatch(ids[i], events[i]) ? 1 : 0;
+        }
+        REQUIRE(stepped.step(ids.data(), events.data(), ids.size()) == taken);
+    }
+    for (instance_id_t i = 0; i < N; ++i) {
+        CHECK(stepped.getState(i) == dispatched.getState(i));
+        CHECK(stepped.context(i).trips == dispatched.context(i).trips);
+    }
+}
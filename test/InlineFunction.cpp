@@ -0,0 +1,137 @@
+#include "Event.h"
+#include "InlineFunction.h"
+#include "Transition.h"
+
+#include <catch2/catch.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+using tsm::ActionFn;
+using tsm::Event;
+using tsm::GuardFn;
+using tsm::InlineFunction;
+
+namespace tsmtest {
+
+struct Dimmer
+{
+    void set(Event const& e) { level = static_cast<int>(e.data); }
+    bool isOn(Event const&) { return level > 0; }
+
+    int level{};
+};
+
+} // namespace tsmtest
+
+using tsmtest::Dimmer;
+
+TEST_CASE("TestInlineFunction - testEmpty")
+{
+    ActionFn a;
+    GuardFn g = nullptr;
+    CHECK_FALSE(a);
+    CHECK_FALSE(g);
+
+    ActionFn copy = a;
+    CHECK_FALSE(copy);
+}
+
+TEST_CASE("TestInlineFunction - testLambdaAndCopies")
+{
+    int calls = 0;
+    ActionFn a = [&calls](Event const& e) { calls += static_cast<int>(e.data); };
+    REQUIRE(a);
+    a(Event(1, 2));
+    CHECK(calls == 2);
+
+    ActionFn b = a;
+    b(Event(1, 3));
+    CHECK(calls == 5);
+
+    a = nullptr;
+    CHECK_FALSE(a);
+    b(Event(1, 1));
+    CHECK(calls == 6);
+}
+
+TEST_CASE("TestInlineFunction - testMemberFunctions")
+{
+    Dimmer d;
+    ActionFn set = ActionFn::bind(&d, &Dimmer::set);
+    GuardFn isOn = GuardFn::bind(&d, &Dimmer::isOn);
+    CHECK_FALSE(isOn(Event(1)));
+    set(Event(1, 7));
+    CHECK(d.level == 7);
+    CHECK(isOn(Event(1)));
+}
+
+TEST_CASE("TestInlineFunction - testNonTrivialCallable")
+{
+    auto counter = std::make_shared<int>(0);
+    {
+        InlineFunction<int()> f = [counter] { return ++*counter; };
+        CHECK(counter.use_count() == 2);
+        InlineFunction<int()> g = f;
+        CHECK(counter.use_count() == 3);
+        CHECK(f() == 1);
+        CHECK(g() == 2);
+        g = nullptr;
+        CHECK(counter.use_count() == 2);
+    }
+    CHECK(counter.use_count() == 1);
+}
+
+TEST_CASE("TestInlineFunction - testLargeCallables")
+{
+    // Too large to store inline, so kept on the heap
+    std::string name(64, 'x');
+    std::size_t seen = 0;
+    ActionFn a = [name, &seen](Event const&) { seen = name.size(); };
+    ActionFn b = a;
+    a = nullptr;
+    b(Event(1));
+    CHECK(seen == 64);
+
+    std::function<bool(Event const&)> f = [](Event const& e) {
+        return e.data > 1;
+    };
+    GuardFn g = f;
+    CHECK(g(Event(1, 2)));
+    CHECK_FALSE(g(Event(1, 0)));
+
+    // An empty std::function is an empty InlineFunction
+    CHECK_FALSE(GuardFn(std::function<bool(Event const&)>()));
+}
+
+TEST_CASE("TestInlineFunction - testMoves")
+{
+    auto counter = std::make_shared<int>(0);
+    InlineFunction<int()> f = [counter] { return ++*counter; };
+    InlineFunction<int()> g = std::move(f);
+    CHECK_FALSE(f);
+    CHECK(counter.use_count() == 2);
+    CHECK(g() == 1);
+
+    std::string big(64, 'y');
+    InlineFunction<std::size_t()> h = [big] { return big.size(); };
+    InlineFunction<std::size_t()> i;
+    i = std::move(h);
+    CHECK_FALSE(h);
+    CHECK(i() == 64);
+}
+
+TEST_CASE("TestInlineFunction - testOnlyMatchingCallables")
+{
+    auto takesEvent = [](Event const&) { return true; };
+    auto takesInt = [](int) { return true; };
+    auto returnsVoid = [](Event const&) {};
+    CHECK(std::is_constructible<GuardFn, decltype(takesEvent)>::value);
+    CHECK_FALSE(std::is_constructible<GuardFn, decltype(takesInt)>::value);
+    CHECK_FALSE(std::is_constructible<GuardFn, decltype(returnsVoid)>::value);
+    // Any result may be dropped by a void function
+    CHECK(std::is_constructible<ActionFn, decltype(takesEvent)>::value);
+}
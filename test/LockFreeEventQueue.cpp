@@ -0,0 +1,171 @@
+#include "LockFreeEventQueue.h"
+#include "AsyncExecutionPolicy.h"
+#include "Event.h"
+#include "Observer.h"
+
+#include "GarageDoorSM.h"
+
+#include <catch2/catch.hpp>
+#include <future>
+#include <set>
+
+using tsm::Event;
+using LockFreeEventQueue = tsm::LockFreeEventQueueT<tsm::Event>;
+
+TEST_CASE("TestLockFreeEventQueue - testSingleEvent")
+{
+    LockFreeEventQueue eq_;
+    Event e1;
+    auto f1 = std::async(std::launch::async, &LockFreeEventQueue::nextEvent, &eq_);
+
+    std::thread t1(&LockFreeEventQueue::addEvent, &eq_, e1);
+
+    Event actualEvent1 = f1.get();
+    t1.join();
+    CHECK(actualEvent1.id == e1.id);
+}
+
+TEST_CASE("TestLockFreeEventQueue - testAddFrom10ThreadsSingleConsumer")
+{
+    LockFreeEventQueue eq_;
+    const int NTHREADS = 10;
+    const int NEVENTS = 1000;
+
+    std::vector<std::thread> vtProduce;
+    for (int t = 0; t < NTHREADS; t++) {
+        vtProduce.emplace_back([&eq_, t] {
+            for (int i = 0; i < NEVENTS; i++) {
+                eq_.addEvent(Event(static_cast<tsm::event_id_t>(t), i));
+            }
+        });
+    }
+
+    // Events from the same producer come out in the order they were added
+    std::vector<int64_t> lastSeen(NTHREADS, -1);
+    for (int i = 0; i < NTHREADS * NEVENTS; i++) {
+        Event e = eq_.nextEvent();
+        REQUIRE(static_cast<int64_t>(e.data) > lastSeen[e.id]);
+        lastSeen[e.id] = e.data;
+    }
+    for (auto last : lastSeen) {
+        CHECK(last == NEVENTS - 1);
+    }
+
+    for (auto&& t : vtProduce) {
+        t.join();
+    }
+}
+
+TEST_CASE("TestLockFreeEventQueue - testStopWakesConsumer")
+{
+    LockFreeEventQueue eq_;
+    auto f1 = std::async(std::launch::async, &LockFreeEventQueue::nextEvent, &eq_);
+    eq_.stop();
+    f1.get();
+    CHECK(eq_.interrupted());
+}
+
+TEST_CASE("TestLockFreeEventQueue - testNextEventsBatch")
+{
+    LockFreeEventQueue eq_;
+    for (tsm::event_id_t i = 0; i < 10; i++) {
+        eq_.addEvent(Event(i));
+    }
+    std::deque<Event> batch;
+    CHECK(eq_.nextEvents(batch, 3) == 3);
+    CHECK(eq_.nextEvents(batch) == 7);
+    REQUIRE(batch.size() == 10);
+    for (tsm::event_id_t i = 0; i < 10; i++) {
+        CHECK(batch[i].id == i);
+    }
+}
+
+TEST_CASE("TestLockFreeEventQueue - testDequeueTakesNoEventIds")
+{
+    const tsm::event_id_t before = Event().id;
+    {
+        LockFreeEventQueue eq_;
+        for (tsm::event_id_t i = 0; i < 10; i++) {
+            eq_.addEvent(Event(i));
+        }
+        for (tsm::event_id_t i = 0; i < 10; i++) {
+            CHECK(eq_.nextEvent().id == i);
+        }
+    }
+    CHECK(Event().id == before + 1);
+}
+
+TEST_CASE("TestLockFreeEventQueue - testAddEventsKeepsRangesContiguous")
+{
+    LockFreeEventQueue eq_;
+    const int NEVENTS = 100;
+    std::vector<Event> a, b;
+    for (int i = 0; i < NEVENTS; i++) {
+        a.emplace_back(1, i);
+        b.emplace_back(2, i);
+    }
+
+    std::thread ta([&] { CHECK(eq_.addEvents(a.begin(), a.end()) == a.size()); });
+    std::thread tb([&] { CHECK(eq_.addEvents(b.begin(), b.end()) == b.size()); });
+
+    for (int range = 0; range < 2; range++) {
+        Event first = eq_.nextEvent();
+        CHECK(first.data == 0);
+        for (int i = 1; i < NEVENTS; i++) {
+            Event e = eq_.nextEvent();
+            CHECK(e.id == first.id);
+            CHECK(e.data == static_cast<tsm::event_data_t>(i));
+        }
+    }
+    ta.join();
+    tb.join();
+}
+
+TEST_CASE("TestLockFreeEventQueue - testSpinThenParkWait")
+{
+    tsm::LockFreeEventQueueT<Event, tsm::SpinThenParkWait<100, 10>> eq_;
+    const int NEVENTS = 1000;
+
+    auto consumer = std::async(std::launch::async, [&eq_] {
+        int n = 0;
+        for (int i = 0; i < NEVENTS; i++) {
+            if (eq_.nextEvent().data == static_cast<tsm::event_data_t>(i)) {
+                n++;
+            }
+        }
+        return n;
+    });
+    for (int i = 0; i < NEVENTS; i++) {
+        eq_.addEvent(Event(1, i));
+        if (i % 100 == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    CHECK(consumer.get() == NEVENTS);
+}
+
+using tsm::BlockingObserver;
+using tsmtest::GarageDoorHsm;
+
+using LockFreeGarageDoorHsm = tsm::
+  AsyncExecWithObserver<GarageDoorHsm, BlockingObserver, LockFreeEventQueue>;
+
+TEST_CASE("TestLockFreeEventQueue - testAsyncExecutionPolicyWithLockFreeQueue")
+{
+    auto sm = std::make_shared<LockFreeGarageDoorHsm>();
+
+    sm->startSM();
+
+    sm->wait();
+    REQUIRE(sm->getCurrentState() == &sm->DoorClosed);
+
+    sm->sendEvent(sm->click_event);
+    sm->wait();
+    REQUIRE(sm->getCurrentState() == &sm->DoorOpening);
+
+    sm->sendEvent(sm->sensor_hi_event);
+    sm->wait();
+    REQUIRE(sm->getCurrentState() == &sm->DoorOpen);
+
+    sm->stopSM();
+}
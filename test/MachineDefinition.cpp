@@ -0,0 +1,197 @@
+#include "Event.h"
+#include "MachineDefinition.h"
+#include "tsm.h"
+
+#include <catch2/catch.hpp>
+
+#include <thread>
+#include <vector>
+
+using tsm::Event;
+using tsm::Machine;
+using tsm::MachineDefinition;
+
+namespace tsmtest {
+
+enum class DoorState
+{
+    Open,
+    Opening,
+    Closing,
+    Closed,
+    StoppedClosing,
+    StoppedOpening,
+    Count
+};
+
+enum class DoorEvent
+{
+    Click,
+    SensorHi,
+    Obstruct,
+    Count
+};
+
+struct Door
+{
+    int opened{};
+    int entries{};
+    bool blocked{};
+};
+
+struct DoorDef
+{
+    using Context = Door;
+    using States = DoorState;
+    static constexpr DoorState initial = DoorState::Closed;
+
+    static void define(MachineDefinition<DoorDef>& d)
+    {
+        ++defined;
+        d.add(DoorState::Closed, DoorEvent::Click, DoorState::Opening);
+        d.add(DoorState::Opening,
+              DoorEvent::SensorHi,
+              DoorState::Open,
+              [](Door& door, Event const&) { ++door.opened; });
+        d.add(DoorState::Open,
+              DoorEvent::Click,
+              DoorState::Closing,
+              nullptr,
+              [](Door& door, Event const&) { return !door.blocked; });
+        d.add(DoorState::Closing, DoorEvent::SensorHi, DoorState::Closed);
+        d.add(DoorState::Opening, DoorEvent::Click, DoorState::StoppedOpening);
+        d.add(DoorState::StoppedOpening, DoorEvent::Click, DoorState::Closing);
+        d.add(
+          DoorState::Closing, DoorEvent::Obstruct, DoorState::StoppedClosing);
+        d.add(DoorState::Closing, DoorEvent::Click, DoorState::StoppedClosing);
+        d.add(DoorState::StoppedClosing, DoorEvent::Click, DoorState::Opening);
+        // Already there, the first one wins
+        d.add(DoorState::Closed, DoorEvent::Click, DoorState::Open);
+        d.onEntry(DoorState::Open,
+                  [](Door& door, Event const&) { ++door.entries; });
+    }
+
+    static int defined;
+};
+
+int DoorDef::defined = 0;
+constexpr DoorState DoorDef::initial;
+
+enum class CounterState
+{
+    Counting,
+    Done,
+    Count
+};
+
+struct Tally
+{
+    int count{};
+    int entries{};
+};
+
+// Increments stay in Counting as internal transitions
+struct CounterDef
+{
+    using Context = Tally;
+    using States = CounterState;
+    static constexpr CounterState initial = CounterState::Counting;
+
+    static void define(MachineDefinition<CounterDef>& d)
+    {
+        d.onEntry(CounterState::Counting,
+                  [](Tally& c, Event const&) { ++c.entries; });
+        d.addInternal(CounterState::Counting,
+                      Event(1),
+                      [](Tally& c, Event const&) { ++c.count; },
+                      [](Tally& c, Event const&) { return c.count < 3; });
+        d.add(CounterState::Counting, Event(2), CounterState::Done);
+    }
+};
+
+constexpr CounterState CounterDef::initial;
+
+} // namespace tsmtest
+
+using tsmtest::Door;
+using tsmtest::DoorDef;
+using tsmtest::DoorEvent;
+using tsmtest::DoorState;
+
+TEST_CASE("TestMachineDefinition - testGarageDoor")
+{
+    Machine<DoorDef> door;
+    door.startSM();
+    REQUIRE(door.is(DoorState::Closed));
+
+    CHECK(door.handle(DoorEvent::Click));
+    REQUIRE(door.is(DoorState::Opening));
+    CHECK(door.handle(DoorEvent::SensorHi));
+    REQUIRE(door.is(DoorState::Open));
+    CHECK(door.context().opened == 1);
+    CHECK(door.context().entries == 1);
+
+    // The guard is evaluated against this instance's context
+    door.context().blocked = true;
+    CHECK_FALSE(door.handle(DoorEvent::Click));
+    REQUIRE(door.is(DoorState::Open));
+    door.context().blocked = false;
+    CHECK(door.handle(DoorEvent::Click));
+    REQUIRE(door.getCurrentState() == DoorState::Closing);
+
+    CHECK(door.handle(DoorEvent::Obstruct));
+    REQUIRE(door.is(DoorState::StoppedClosing));
+    CHECK_FALSE(door.handle(DoorEvent::Obstruct));
+    CHECK_FALSE(door.handle(Event(7)));
+    REQUIRE(door.is(DoorState::StoppedClosing));
+    door.stopSM();
+}
+
+TEST_CASE("TestMachineDefinition - testSharedDefinition")
+{
+    // Instances carry their state and context, nothing else
+    CHECK(sizeof(Machine<DoorDef>) <= sizeof(Door) + sizeof(int));
+
+    std::vector<Machine<DoorDef>> doors(1000);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&doors, t] {
+            for (std::size_t i = t; i < doors.size(); i += 4) {
+                doors[i].startSM();
+                doors[i].handle(DoorEvent::Click);
+                doors[i].handle(DoorEvent::SensorHi);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    for (auto const& door : doors) {
+        CHECK(door.is(DoorState::Open));
+        CHECK(door.context().opened == 1);
+    }
+
+    // One definition, built once, for every instance
+    CHECK(DoorDef::defined == 1);
+    CHECK(&doors[0].definition() == &doors[999].definition());
+    CHECK(doors[0].definition().transitionCount() == 9);
+    CHECK(doors[0].definition().eventCount() == 3);
+}
+
+TEST_CASE("TestMachineDefinition - testInternalTransition")
+{
+    Machine<tsmtest::CounterDef> counter;
+    counter.startSM();
+    CHECK(counter.context().entries == 1);
+    for (int i = 0; i < 5; ++i) {
+        counter.handle(Event(1));
+    }
+    // The guard stops it at 3, and Counting is never re-entered
+    CHECK(counter.context().count == 3);
+    CHECK(counter.context().entries == 1);
+    CHECK(counter.is(tsmtest::CounterState::Counting));
+    CHECK(counter.definition().tableBytes() ==
+          2 * sizeof(tsm::PackedTransition) + 2 * 2 * sizeof(uint16_t));
+    CHECK(counter.handle(Event(2)));
+    CHECK(counter.is(tsmtest::CounterState::Done));
+}
@@ -160,3 +160,37 @@ TEST_CASE("TestOrthogonalCdPlayerHsm - testOrthogonalHsmSingleThread")
 
     sm->stopSM();
 }
+
+TEST_CASE("TestOrthogonalCdPlayerHsm - testRouting")
+{
+    auto sm = std::make_shared<OrthogonalCdPlayerHsmSingleThread>();
+    auto* cdPlayerHsm = &std::get<0>(sm->sms_);
+    auto* errorHsm = &std::get<1>(sm->sms_);
+
+    CHECK(sm->getEvents().size() ==
+          cdPlayerHsm->getEvents().size() + errorHsm->getEvents().size());
+
+    sm->startSM();
+
+    // Goes straight to the second region
+    sm->sendEvent(errorHsm->error);
+    sm->step();
+    REQUIRE(errorHsm->getCurrentState() == &errorHsm->ErrorMode);
+    REQUIRE(cdPlayerHsm->getCurrentState() == &cdPlayerHsm->Empty);
+
+    sm->sendEvent(cdPlayerHsm->cd_detected);
+    sm->step();
+    REQUIRE(cdPlayerHsm->getCurrentState() == &cdPlayerHsm->Stopped);
+
+    // Known to the region but not handled in its current state: dropped at
+    // the top instead of being routed back to the same region
+    sm->sendEvent(cdPlayerHsm->cd_detected);
+    sm->step();
+    REQUIRE(cdPlayerHsm->getCurrentState() == &cdPlayerHsm->Stopped);
+
+    sm->sendEvent(errorHsm->error);
+    sm->step();
+    REQUIRE(errorHsm->getCurrentState() == &errorHsm->ErrorMode);
+
+    sm->stopSM();
+}
@@ -0,0 +1,211 @@
+#include "Event.h"
+#include "Hsm.h"
+#include "Observer.h"
+#include "OrthogonalHsm.h"
+#include "PooledExecutionPolicy.h"
+#include "State.h"
+#include "ThreadPoolExecutor.h"
+#include "tsm.h"
+
+#include <catch2/catch.hpp>
+
+#include <memory>
+#include <vector>
+
+using tsm::Event;
+using tsm::Hsm;
+using tsm::OrthogonalHsm;
+using tsm::RegionDelivery;
+using tsm::SingleThreadedExecutionPolicy;
+using tsm::State;
+using tsm::ThreadPoolExecutor;
+
+namespace tsmtest {
+
+// Shared by both regions
+const tsm::event_id_t POWER_ID = 100000;
+
+std::vector<int> deliveries;
+
+struct Lamp : public Hsm<Lamp>
+{
+    Lamp()
+    {
+        setStartState(&off);
+        add(off, power, on, [](Event const&) { deliveries.push_back(1); });
+        add(on, power, off, [](Event const&) { deliveries.push_back(1); });
+    }
+
+    State off, on;
+    Event power{ POWER_ID };
+};
+
+struct Fan : public Hsm<Fan>
+{
+    Fan()
+    {
+        setStartState(&stopped);
+        add(stopped, power, spinning, [](Event const&) {
+            deliveries.push_back(2);
+        });
+        add(spinning, speed, stopped);
+    }
+
+    State stopped, spinning;
+    Event power{ POWER_ID }, speed;
+};
+
+const tsm::event_id_t WORK_ID = 100001;
+
+// A region that does some work on every work event
+template<int N>
+struct Busy : public Hsm<Busy<N>>
+{
+    Busy()
+    {
+        this->setStartState(&idle);
+        this->add(idle, work, done, count);
+        this->add(done, work, idle, count);
+    }
+
+    tsm::ActionFn count = [this](Event const&) {
+        for (int i = 0; i < 1000; ++i) {
+            sum += i;
+        }
+        ++runs;
+    };
+
+    State idle, done;
+    Event work{ WORK_ID };
+    int runs{};
+    volatile long sum{};
+};
+
+// A region that stops, and so is exited, on the first work event
+template<int N>
+struct Finite : public Hsm<Finite<N>>
+{
+    Finite()
+    {
+        this->setStartState(&idle);
+        this->setStopState(&stopped);
+        this->add(idle, work, stopped);
+    }
+
+    State idle, stopped;
+    Event work{ WORK_ID };
+};
+
+} // namespace tsmtest
+
+using tsmtest::Busy;
+using tsmtest::Fan;
+using tsmtest::Lamp;
+using Room = SingleThreadedExecutionPolicy<OrthogonalHsm<Lamp, Fan>>;
+
+TEST_CASE("TestOrthogonalHsm - testFirstDelivery")
+{
+    tsmtest::deliveries.clear();
+    auto sm = std::make_shared<Room>();
+    auto& lamp = std::get<0>(sm->sms_);
+    auto& fan = std::get<1>(sm->sms_);
+    REQUIRE(sm->getDelivery() == RegionDelivery::First);
+    sm->startSM();
+
+    sm->sendEvent(Event(tsmtest::POWER_ID));
+    sm->step();
+    CHECK(lamp.getCurrentState() == &lamp.on);
+    CHECK(fan.getCurrentState() == &fan.stopped);
+    CHECK(tsmtest::deliveries == std::vector<int>{ 1 });
+    sm->stopSM();
+}
+
+TEST_CASE("TestOrthogonalHsm - testBroadcastDelivery")
+{
+    tsmtest::deliveries.clear();
+    auto sm = std::make_shared<Room>();
+    auto& lamp = std::get<0>(sm->sms_);
+    auto& fan = std::get<1>(sm->sms_);
+    sm->setDelivery(RegionDelivery::Broadcast);
+    sm->startSM();
+
+    sm->sendEvent(Event(tsmtest::POWER_ID));
+    sm->step();
+    CHECK(lamp.getCurrentState() == &lamp.on);
+    CHECK(fan.getCurrentState() == &fan.spinning);
+    // In region order
+    CHECK(tsmtest::deliveries == std::vector<int>{ 1, 2 });
+
+    // Only the lamp reacts now, the fan declines
+    sm->sendEvent(Event(tsmtest::POWER_ID));
+    sm->step();
+    CHECK(lamp.getCurrentState() == &lamp.off);
+    CHECK(fan.getCurrentState() == &fan.spinning);
+    CHECK(tsmtest::deliveries == std::vector<int>{ 1, 2, 1 });
+
+    sm->sendEvent(fan.speed);
+    sm->step();
+    CHECK(fan.getCurrentState() == &fan.stopped);
+    sm->stopSM();
+}
+
+TEST_CASE("TestOrthogonalHsm - testParallelBroadcast")
+{
+    ThreadPoolExecutor pool(3);
+    OrthogonalHsm<Busy<0>, Busy<1>, Busy<2>, Busy<3>> sm;
+    sm.setDelivery(RegionDelivery::Broadcast);
+    sm.setExecutor(&pool);
+    sm.startSM();
+
+    const int EVENTS = 101;
+    for (int i = 0; i < EVENTS; ++i) {
+        sm.dispatch(Event(tsmtest::WORK_ID));
+    }
+    CHECK(std::get<0>(sm.sms_).runs == EVENTS);
+    CHECK(std::get<1>(sm.sms_).runs == EVENTS);
+    CHECK(std::get<2>(sm.sms_).runs == EVENTS);
+    CHECK(std::get<3>(sm.sms_).runs == EVENTS);
+    CHECK(std::get<3>(sm.sms_).getCurrentState() == &std::get<3>(sm.sms_).done);
+    sm.stopSM();
+}
+
+TEST_CASE("TestOrthogonalHsm - testParallelBroadcastFromWorker")
+{
+    // The only worker is the one delivering, so the helper tasks cannot run
+    // until each event is done
+    ThreadPoolExecutor pool(1);
+    using Regions = OrthogonalHsm<Busy<0>, Busy<1>, Busy<2>>;
+    tsm::PooledExecWithObserver<Regions, tsm::BlockingObserver> sm(pool);
+    sm.setDelivery(RegionDelivery::Broadcast);
+    sm.setExecutor(&pool);
+    sm.startSM();
+    sm.wait();
+
+    const int EVENTS = 20;
+    for (int i = 0; i < EVENTS; ++i) {
+        REQUIRE(sm.sendEvent(Event(tsmtest::WORK_ID)));
+        sm.wait();
+    }
+    CHECK(std::get<0>(sm.sms_).runs == EVENTS);
+    CHECK(std::get<1>(sm.sms_).runs == EVENTS);
+    CHECK(std::get<2>(sm.sms_).runs == EVENTS);
+    sm.stopSM();
+}
+
+TEST_CASE("TestOrthogonalHsm - testParallelBroadcastExitsRegions")
+{
+    ThreadPoolExecutor pool(3);
+    OrthogonalHsm<Busy<0>, tsmtest::Finite<1>, tsmtest::Finite<2>> sm;
+    sm.setDelivery(RegionDelivery::Broadcast);
+    sm.setExecutor(&pool);
+    sm.startSM();
+    REQUIRE(sm.getCurrentHsm() == &std::get<0>(sm.sms_));
+
+    // The regions' exits are applied by the delivering thread afterwards
+    sm.dispatch(Event(tsmtest::WORK_ID));
+    CHECK(std::get<0>(sm.sms_).runs == 1);
+    CHECK(std::get<1>(sm.sms_).getCurrentState() == nullptr);
+    CHECK(std::get<2>(sm.sms_).getCurrentState() == nullptr);
+    CHECK(sm.getCurrentHsm() == nullptr);
+    sm.stopSM();
+}
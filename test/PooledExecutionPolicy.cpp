@@ -0,0 +1,171 @@
+#include "PooledExecutionPolicy.h"
+#include "Event.h"
+#include "Hsm.h"
+#include "Observer.h"
+#include "State.h"
+#include "ThreadPoolExecutor.h"
+#include "WorkStealingExecutor.h"
+
+#include "GarageDoorSM.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using tsm::Event;
+using tsm::Hsm;
+using tsm::State;
+using tsm::ThreadPoolExecutor;
+using tsm::WorkStealingExecutor;
+
+namespace tsmtest {
+
+///
+/// Checks that its events are dispatched one at a time and in order.
+///
+struct Counter : Hsm<Counter>
+{
+    Counter()
+    {
+        setStartState(&counting);
+        add(counting, tick, counting, onTick);
+    }
+
+    tsm::ActionFn onTick = [this](Event const& e) {
+        if (busy_.exchange(true)) {
+            overlapped = true;
+        }
+        if (e.data != expected) {
+            outOfOrder = true;
+        }
+        ++expected;
+        busy_ = false;
+        ++processed;
+    };
+
+    State counting;
+    Event tick;
+    tsm::event_data_t expected{};
+    std::atomic<bool> overlapped{};
+    std::atomic<bool> outOfOrder{};
+    static std::atomic<int> processed;
+
+  private:
+    std::atomic<bool> busy_{};
+};
+
+std::atomic<int> Counter::processed{};
+
+} // namespace tsmtest
+
+using tsm::BlockingObserver;
+using tsmtest::Counter;
+using tsmtest::GarageDoorHsm;
+
+using PooledGarageDoorHsm =
+  tsm::PooledExecWithObserver<GarageDoorHsm, BlockingObserver>;
+
+TEST_CASE("TestPooledExecutionPolicy - testGarageDoor")
+{
+    ThreadPoolExecutor pool(2);
+    auto sm = std::make_shared<PooledGarageDoorHsm>(pool);
+
+    sm->startSM();
+
+    sm->wait();
+    REQUIRE(sm->getCurrentState() == &sm->DoorClosed);
+
+    REQUIRE(sm->sendEvent(sm->click_event));
+    sm->wait();
+    REQUIRE(sm->getCurrentState() == &sm->DoorOpening);
+
+    REQUIRE(sm->sendEvent(sm->sensor_hi_event));
+    sm->wait();
+    REQUIRE(sm->getCurrentState() == &sm->DoorOpen);
+
+    sm->stopSM();
+    CHECK_FALSE(sm->sendEvent(sm->click_event));
+}
+
+template<typename Executor>
+void
+runManyMachines(Executor& executor)
+{
+    using PooledCounter = tsm::PooledExecutionPolicy<Counter, Executor>;
+    const int NMACHINES = 1000;
+    const int NEVENTS = 50;
+
+    std::vector<std::unique_ptr<PooledCounter>> machines;
+    Counter::processed = 0;
+    for (int i = 0; i < NMACHINES; i++) {
+        machines.emplace_back(new PooledCounter(executor));
+        machines.back()->setBatchSize(i % 8);
+        machines.back()->startSM();
+    }
+
+    // Two producers per machine range, interleaving with the workers
+    auto produce = [&machines](int first, int last) {
+        for (int e = 0; e < NEVENTS; e++) {
+            for (int i = first; i < last; i++) {
+                auto& m = *machines[i];
+                m.sendEvent(Event(m.tick.id, e));
+            }
+        }
+    };
+    std::thread p1(produce, 0, NMACHINES / 2);
+    std::thread p2(produce, NMACHINES / 2, NMACHINES);
+    p1.join();
+    p2.join();
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (Counter::processed < NMACHINES * NEVENTS &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(Counter::processed == NMACHINES * NEVENTS);
+    for (auto const& m : machines) {
+        CHECK_FALSE(m->overlapped);
+        CHECK_FALSE(m->outOfOrder);
+        // Every machine has been run, so it is pinned to some worker
+        CHECK(m->getAffinity() < executor.size());
+    }
+}
+
+TEST_CASE("TestPooledExecutionPolicy - testManyMachinesFewWorkers")
+{
+    ThreadPoolExecutor pool(4);
+    runManyMachines(pool);
+}
+
+TEST_CASE("TestPooledExecutionPolicy - testManyMachinesWorkStealing")
+{
+    WorkStealingExecutor pool(4);
+    runManyMachines(pool);
+}
+
+TEST_CASE("TestPooledExecutionPolicy - testEventsBeforeStartAreKept")
+{
+    using PooledCounter = tsm::PooledExecutionPolicy<Counter>;
+    ThreadPoolExecutor pool(1);
+    Counter::processed = 0;
+    {
+        PooledCounter m(pool);
+        std::vector<Event> events{ Event(m.tick.id, 0), Event(m.tick.id, 1) };
+        CHECK(m.sendEvents(events.begin(), events.end()) == 2);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        CHECK(Counter::processed == 0);
+        m.startSM();
+        auto deadline =
+          std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (Counter::processed < 2 &&
+               std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        CHECK(Counter::processed == 2);
+        CHECK_FALSE(m.outOfOrder);
+    }
+}
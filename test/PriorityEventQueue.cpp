@@ -0,0 +1,138 @@
+#include "PriorityEventQueue.h"
+#include "AsyncExecutionPolicy.h"
+#include "Event.h"
+#include "Observer.h"
+
+#include "GarageDoorSM.h"
+
+#include <catch2/catch.hpp>
+#include <future>
+
+using tsm::Event;
+using tsm::EventPriority;
+using PriorityEventQueue = tsm::PriorityEventQueue<tsm::Event>;
+
+TEST_CASE("TestPriorityEventQueue - testFifoWithinLane")
+{
+    PriorityEventQueue eq_;
+    for (tsm::event_id_t i = 0; i < 10; i++) {
+        eq_.addEvent(Event(i));
+    }
+    for (tsm::event_id_t i = 0; i < 10; i++) {
+        CHECK(eq_.nextEvent().id == i);
+    }
+}
+
+TEST_CASE("TestPriorityEventQueue - testUrgentOvertakesBulkBacklog")
+{
+    PriorityEventQueue eq_;
+    Event telemetry(1), error(2), stop(3);
+    eq_.setPriority(telemetry, EventPriority::Bulk);
+    eq_.setPriority(error, EventPriority::Urgent);
+    eq_.setPriority(stop, EventPriority::Control);
+
+    for (int i = 0; i < 1000; i++) {
+        eq_.addEvent(telemetry);
+    }
+    eq_.addEvent(Event(error.id, 0));
+    eq_.addEvent(Event(error.id, 1));
+    eq_.addEvent(stop);
+
+    CHECK(eq_.nextEvent().id == stop.id);
+    Event e = eq_.nextEvent();
+    CHECK(e.id == error.id);
+    CHECK(e.data == 0);
+    e = eq_.nextEvent();
+    CHECK(e.id == error.id);
+    CHECK(e.data == 1);
+    CHECK(eq_.nextEvent().id == telemetry.id);
+    CHECK(eq_.size() == 999);
+}
+
+TEST_CASE("TestPriorityEventQueue - testExplicitLane")
+{
+    PriorityEventQueue eq_;
+    eq_.addEvent(Event(1));
+    eq_.addEvent(Event(2), EventPriority::Control);
+    // Out of range lanes go to the lowest priority lane
+    eq_.addEvent(Event(3), 100);
+    CHECK(eq_.nextEvent().id == 2);
+    CHECK(eq_.nextEvent().id == 1);
+    CHECK(eq_.nextEvent().id == 3);
+}
+
+TEST_CASE("TestPriorityEventQueue - testStarvationLimit")
+{
+    PriorityEventQueue eq_;
+    Event urgent(1), bulk(2);
+    eq_.setPriority(urgent, EventPriority::Urgent);
+    eq_.setPriority(bulk, EventPriority::Bulk);
+    eq_.setStarvationLimit(3);
+
+    for (int i = 0; i < 10; i++) {
+        eq_.addEvent(urgent);
+    }
+    eq_.addEvent(bulk);
+
+    std::deque<Event> batch;
+    CHECK(eq_.nextEvents(batch) == 11);
+    REQUIRE(batch.size() == 11);
+    // Passed over three times, the bulk event is served next
+    CHECK(batch[3].id == bulk.id);
+}
+
+TEST_CASE("TestPriorityEventQueue - testNextEventsInPriorityOrder")
+{
+    PriorityEventQueue eq_;
+    std::vector<Event> events;
+    for (tsm::event_id_t i = 0; i < 4; i++) {
+        events.emplace_back(i);
+        eq_.setPriority(events.back(), 3 - i);
+    }
+    CHECK(eq_.addEvents(events.begin(), events.end()) == 4);
+
+    std::deque<Event> batch;
+    CHECK(eq_.nextEvents(batch, 2) == 2);
+    CHECK(eq_.nextEvents(batch) == 2);
+    REQUIRE(batch.size() == 4);
+    for (tsm::event_id_t i = 0; i < 4; i++) {
+        CHECK(batch[i].id == 3 - i);
+    }
+}
+
+TEST_CASE("TestPriorityEventQueue - testStopWakesConsumer")
+{
+    PriorityEventQueue eq_;
+    auto f1 =
+      std::async(std::launch::async, &PriorityEventQueue::nextEvent, &eq_);
+    eq_.stop();
+    f1.get();
+    CHECK(eq_.interrupted());
+}
+
+using tsm::BlockingObserver;
+using tsmtest::GarageDoorHsm;
+
+using PriorityGarageDoorHsm =
+  tsm::AsyncExecWithObserver<GarageDoorHsm, BlockingObserver, PriorityEventQueue>;
+
+TEST_CASE("TestPriorityEventQueue - testAsyncExecutionPolicyWithPriorityQueue")
+{
+    auto sm = std::make_shared<PriorityGarageDoorHsm>();
+    sm->getEventQueue().setPriority(sm->click_event, EventPriority::Urgent);
+
+    sm->startSM();
+
+    sm->wait();
+    REQUIRE(sm->getCurrentState() == &sm->DoorClosed);
+
+    sm->sendEvent(sm->click_event);
+    sm->wait();
+    REQUIRE(sm->getCurrentState() == &sm->DoorOpening);
+
+    sm->sendEvent(sm->sensor_hi_event);
+    sm->wait();
+    REQUIRE(sm->getCurrentState() == &sm->DoorOpen);
+
+    sm->stopSM();
+}
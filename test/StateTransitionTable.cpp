@@ -0,0 +1,135 @@
+#include "Event.h"
+#include "State.h"
+#include "Transition.h"
+#include "tsm.h"
+
+#include <catch2/catch.hpp>
+
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+using tsm::Event;
+using tsm::Hsm;
+using tsm::SingleThreadedHsm;
+using tsm::State;
+using tsm::StateTransitionTableT;
+
+namespace tsmtest {
+
+struct FrozenSwitch : public Hsm<FrozenSwitch>
+{
+    FrozenSwitch()
+    {
+        setStartState(&off);
+        add(off, toggle, on);
+        add(on, toggle, off);
+    }
+
+    State on, off;
+    Event toggle;
+};
+
+struct NoDef
+{};
+
+} // namespace tsmtest
+
+using tsmtest::FrozenSwitch;
+using tsmtest::NoDef;
+
+TEST_CASE("TestStateTransitionTable - testFrozenLookup")
+{
+    StateTransitionTableT<NoDef> table;
+    std::vector<std::unique_ptr<State>> states;
+    for (int i = 0; i < 40; i++) {
+        states.emplace_back(new State());
+    }
+    // Large event ids, which used to overflow the pair hash
+    std::vector<Event> events;
+    for (tsm::event_id_t id = 0; id < 30; id++) {
+        events.emplace_back(0xFFFF0000U + id * 7919U);
+    }
+    for (std::size_t s = 0; s < states.size(); s++) {
+        for (std::size_t e = 0; e < events.size(); e++) {
+            if ((s + e) % 2 == 0) {
+                table.add(*states[s], events[e], *states[(s + e) % 40]);
+            }
+        }
+    }
+
+    table.freeze();
+    REQUIRE(table.isFrozen());
+    for (std::size_t s = 0; s < states.size(); s++) {
+        for (std::size_t e = 0; e < events.size(); e++) {
+            auto* t = table.next(*states[s], events[e]);
+            if ((s + e) % 2 == 0) {
+                REQUIRE(t != nullptr);
+                CHECK(&t->toState == states[(s + e) % 40].get());
+            } else {
+                CHECK(t == nullptr);
+            }
+        }
+    }
+    State unknownState;
+    CHECK(table.next(unknownState, events[0]) == nullptr);
+    CHECK(table.next(*states[0], Event(3)) == nullptr);
+
+    // Adding thaws the table, and the new transition is found either way
+    table.add(*states[1], events[0], unknownState);
+    CHECK_FALSE(table.isFrozen());
+    CHECK(&table.next(*states[1], events[0])->toState == &unknownState);
+    table.freeze();
+    CHECK(&table.next(*states[1], events[0])->toState == &unknownState);
+}
+
+TEST_CASE("TestStateTransitionTable - testEmptyTable")
+{
+    StateTransitionTableT<NoDef> table;
+    table.freeze();
+    State s;
+    CHECK(table.next(s, Event(1)) == nullptr);
+}
+
+TEST_CASE("TestStateTransitionTable - testHsmFreezesOnStart")
+{
+    auto sm = std::make_shared<SingleThreadedHsm<FrozenSwitch>>();
+    REQUIRE_FALSE(sm->getTable().isFrozen());
+    sm->startSM();
+    REQUIRE(sm->getTable().isFrozen());
+    REQUIRE(sm->getCurrentState() == &sm->off);
+
+    sm->sendEvent(sm->toggle);
+    sm->step();
+    REQUIRE(sm->getCurrentState() == &sm->on);
+    sm->sendEvent(sm->toggle);
+    sm->step();
+    REQUIRE(sm->getCurrentState() == &sm->off);
+    sm->stopSM();
+}
+
+TEST_CASE("TestStateTransitionTable - testIdsAcrossThreads")
+{
+    std::unique_ptr<FrozenSwitch> a, b;
+    std::thread ta([&a] { a.reset(new FrozenSwitch()); });
+    std::thread tb([&b] { b.reset(new FrozenSwitch()); });
+    ta.join();
+    tb.join();
+
+    // Ids are unique process wide, whichever thread made the machine
+    std::set<tsm::id_t> ids{ a->on.id, a->off.id, b->on.id, b->off.id };
+    CHECK(ids.size() == 4);
+    CHECK(a->toggle != b->toggle);
+
+    // Dense indices depend only on the machine type
+    CHECK(a->stateCount() == 2);
+    CHECK(a->eventCount() == 1);
+    CHECK(a->stateIndex(a->off) == 0);
+    CHECK(a->stateIndex(a->on) == 1);
+    CHECK(b->stateIndex(b->off) == 0);
+    CHECK(b->stateIndex(b->on) == 1);
+    CHECK(a->eventIndex(a->toggle) == 0);
+    CHECK(b->eventIndex(b->toggle) == 0);
+    CHECK(a->stateIndex(b->on) == std::size_t(tsm::DenseIndex::NONE));
+}
@@ -0,0 +1,161 @@
+#include "StaticHsm.h"
+#include "Event.h"
+#include "tsm.h"
+
+#include <catch2/catch.hpp>
+
+#include <memory>
+
+using tsm::Event;
+using tsm::Row;
+using tsm::SingleThreadedHsm;
+using tsm::StaticHsm;
+using tsm::TransitionTable;
+
+namespace tsmtest {
+
+// States
+struct Idle
+{};
+struct Running
+{};
+struct Coasting
+{};
+
+// Events
+struct Start
+{
+    static constexpr tsm::event_id_t id = 1001;
+};
+struct Stop
+{
+    static constexpr tsm::event_id_t id = 1002;
+};
+struct Unused
+{
+    static constexpr tsm::event_id_t id = 1003;
+};
+
+// Actions and guards
+struct CountStarts
+{
+    template<typename M>
+    void operator()(M& m, Event const& e) const
+    {
+        ++m.starts;
+        m.lastData = e.data;
+    }
+};
+
+struct HasPower
+{
+    template<typename M>
+    bool operator()(M& m, Event const&) const
+    {
+        return m.power;
+    }
+};
+
+struct Motor : StaticHsm<Motor>
+{
+    using initial_state = Idle;
+    using transitions =
+      TransitionTable<Row<Idle, Start, Running, CountStarts, HasPower>,
+                      // Taken when the guard above fails
+                      Row<Idle, Start, Coasting>,
+                      Row<Running, Stop, Idle>,
+                      Row<Coasting, Stop, Idle>>;
+
+    bool power{ true };
+    int starts{};
+    tsm::event_data_t lastData{};
+};
+
+struct Off
+{};
+
+// Exits itself once it reaches Off
+struct OneShot : StaticHsm<OneShot>
+{
+    using initial_state = Idle;
+    using stop_state = Off;
+    using transitions =
+      TransitionTable<Row<Idle, Start, Running>, Row<Running, Stop, Off>>;
+};
+
+} // namespace tsmtest
+
+using tsmtest::Coasting;
+using tsmtest::Idle;
+using tsmtest::Motor;
+using tsmtest::Running;
+using tsmtest::Start;
+using tsmtest::Stop;
+
+TEST_CASE("TestStaticHsm - testTransitionsGuardsAndActions")
+{
+    auto sm = std::make_shared<SingleThreadedHsm<Motor>>();
+    sm->startSM();
+    REQUIRE(sm->is<Idle>());
+    REQUIRE(sm->getCurrentState() == &sm->state<Idle>());
+
+    sm->sendEvent(tsm::eventOf<Start>(7));
+    sm->step();
+    REQUIRE(sm->is<Running>());
+    REQUIRE(sm->getCurrentState() == &sm->state<Running>());
+    CHECK(sm->starts == 1);
+    CHECK(sm->lastData == 7);
+
+    // Not handled in Running: nothing changes
+    sm->sendEvent(tsm::eventOf<Start>());
+    sm->step();
+    REQUIRE(sm->is<Running>());
+
+    sm->sendEvent(tsm::eventOf<Stop>());
+    sm->step();
+    REQUIRE(sm->is<Idle>());
+
+    // The guard fails, so the alternative row is taken
+    sm->power = false;
+    sm->sendEvent(tsm::eventOf<Start>());
+    sm->step();
+    REQUIRE(sm->is<Coasting>());
+    CHECK(sm->starts == 1);
+
+    // Unknown event ids are ignored
+    sm->sendEvent(Event(42));
+    sm->step();
+    REQUIRE(sm->is<Coasting>());
+
+    sm->stopSM();
+}
+
+TEST_CASE("TestStaticHsm - testGetEvents")
+{
+    Motor m;
+    auto const& events = m.getEvents();
+    CHECK(events.size() == 2);
+    CHECK(events.count(Event(Start::id)) == 1);
+    CHECK(events.count(Event(Stop::id)) == 1);
+    CHECK(events.count(Event(tsmtest::Unused::id)) == 0);
+}
+
+TEST_CASE("TestStaticHsm - testStopState")
+{
+    using tsmtest::Off;
+    auto sm = std::make_shared<SingleThreadedHsm<tsmtest::OneShot>>();
+    REQUIRE(sm->getStopState() == &sm->state<Off>());
+    CHECK(Motor().getStopState() == nullptr);
+    sm->startSM();
+    REQUIRE(sm->getCurrentState() == &sm->state<Idle>());
+
+    sm->sendEvent(tsm::eventOf<Start>());
+    sm->step();
+    REQUIRE(sm->is<Running>());
+
+    // Entering the stop state exits the machine
+    sm->sendEvent(tsm::eventOf<Stop>());
+    sm->step();
+    CHECK(sm->is<Off>());
+    CHECK(sm->getCurrentState() == nullptr);
+}
@@ -5,6 +5,9 @@
 
 #include <catch2/catch.hpp>
 
+#include <atomic>
+#include <vector>
+
 using tsm::AsyncExecutionPolicy;
 using tsm::Event;
 using tsm::Hsm;
@@ -121,3 +124,75 @@ TEST_CASE("TestSwitch - testSwitchCustomLogging")
     }
 
 }
+
+// Batch mode drains all pending toggles with a single queue access.
+TEST_CASE("TestSwitch - testSwitchBatchMode")
+{
+    using namespace std::chrono_literals;
+    AsyncExecutionPolicy<Switch> mySwitch;
+    constexpr const uint32_t TOGGLE_COUNT = 100;
+    mySwitch.setBatchSize(0);
+    mySwitch.startSM();
+    for (uint32_t i = 0; i < TOGGLE_COUNT; ++i) {
+        mySwitch.sendEvent(mySwitch.toggle);
+    }
+    while (mySwitch.getToggles() != TOGGLE_COUNT) {
+        std::this_thread::sleep_for(1ms);
+    }
+    REQUIRE(mySwitch.getCurrentState() == &mySwitch.off);
+    mySwitch.stopSM();
+}
+
+namespace tsmtest {
+struct CountingObserver
+{
+    void notify() { ++notified; }
+    std::atomic<uint32_t> notified{};
+};
+} // namespace tsmtest
+
+// The observer hears about each batch once, after its last event.
+TEST_CASE("TestSwitch - testSwitchBatchModeWithObserver")
+{
+    using namespace std::chrono_literals;
+    tsm::AsyncExecWithObserver<Switch, tsmtest::CountingObserver> mySwitch;
+    constexpr const uint32_t TOGGLE_COUNT = 100;
+    mySwitch.setBatchSize(0);
+    std::vector<Event> toggles(TOGGLE_COUNT, mySwitch.toggle);
+    // Queued before the thread starts, so they are taken as one batch
+    mySwitch.sendEvents(toggles.begin(), toggles.end());
+    mySwitch.startSM();
+    while (mySwitch.getToggles() != TOGGLE_COUNT || mySwitch.notified < 2) {
+        std::this_thread::sleep_for(1ms);
+    }
+    CHECK(mySwitch.notified == 2);
+    mySwitch.stopSM();
+}
+
+TEST_CASE("TestSwitch - testSwitchSendEvents")
+{
+    using namespace std::chrono_literals;
+    constexpr const uint32_t TOGGLE_COUNT = 10;
+
+    tsm::SingleThreadedHsm<Switch> syncSwitch;
+    std::vector<Event> toggles(TOGGLE_COUNT, syncSwitch.toggle);
+    syncSwitch.startSM();
+    REQUIRE(syncSwitch.sendEvents(toggles.begin(), toggles.end()) ==
+            TOGGLE_COUNT);
+    for (uint32_t i = 0; i < TOGGLE_COUNT; ++i) {
+        syncSwitch.step();
+    }
+    REQUIRE(syncSwitch.getToggles() == TOGGLE_COUNT);
+    syncSwitch.stopSM();
+
+    AsyncExecutionPolicy<Switch> asyncSwitch;
+    toggles.assign(TOGGLE_COUNT, asyncSwitch.toggle);
+    asyncSwitch.startSM();
+    REQUIRE(asyncSwitch.sendEvents(toggles.begin(), toggles.end()) ==
+            TOGGLE_COUNT);
+    while (asyncSwitch.getToggles() != TOGGLE_COUNT) {
+        std::this_thread::sleep_for(1ms);
+    }
+    REQUIRE(asyncSwitch.getCurrentState() == &asyncSwitch.off);
+    asyncSwitch.stopSM();
+}